@@ -0,0 +1,20 @@
+import { compileCondition } from '../emulation/condition';
+
+describe('compileCondition', () => {
+  it('reads hex and decimal numbers alike', () => {
+    const expected = compileCondition('[255] == 1');
+
+    expect(compileCondition('[0xff] == 1')).toEqual(expected);
+    expect(compileCondition('[$FF] == 1')).toEqual(expected);
+  });
+
+  it('rejects bare hex digits', () => {
+    expect(() => compileCondition('[ff] == 1')).toThrow('Unknown symbol "ff"');
+    expect(() => compileCondition('dead')).toThrow('Unknown symbol "dead"');
+  });
+
+  it('rejects names inherited from Object', () => {
+    expect(() => compileCondition('constructor')).toThrow('Unknown symbol');
+    expect(() => compileCondition('__proto__ == 1')).toThrow('Unknown symbol');
+  });
+});
@@ -226,6 +226,27 @@ export default function Debugger() {
         <Tooltip content="Reset" compact>
           <Button icon="reset" onClick={() => context.system.reset()} />
         </Tooltip>
+        <Tooltip content="Reverse Continue" compact>
+          <Button
+            icon="fast-backward"
+            disabled={running}
+            onClick={() => context.system.reverseContinue()}
+          />
+        </Tooltip>
+        <Tooltip content="Reverse Step Over" compact>
+          <Button
+            icon="arrow-top-left"
+            disabled={running}
+            onClick={() => context.system.reverseStepOver()}
+          />
+        </Tooltip>
+        <Tooltip content="Step Back" compact>
+          <Button
+            icon="arrow-left"
+            disabled={running}
+            onClick={() => context.system.stepBack()}
+          />
+        </Tooltip>
         <Tooltip content="Step" compact>
           <Button icon="arrow-right" onClick={() => context.system.step()} />
         </Tooltip>
@@ -26,6 +26,7 @@ import FragmentShader from './shaders/fragment.glsl';
 
 const VRAM_WIDTH = 96;
 const VRAM_HEIGHT = 64;
+const ALL_ROWS = (1n << BigInt(VRAM_HEIGHT)) - 1n;
 
 export default function Screen() {
   const context = useContext(SystemContext);
@@ -38,6 +39,7 @@ export default function Screen() {
   let attributes = {};
   let uniforms = {};
   let animID: number = 0;
+  let uploaded = false;
 
   function init() {
     const gl = canvasRef.current?.getContext('webgl2', {
@@ -169,18 +171,42 @@ export default function Screen() {
       }
     }
 
-    gl.bindTexture(gl.TEXTURE_2D, tex);
-    gl.texSubImage2D(
-      gl.TEXTURE_2D,
-      0,
-      0,
-      0,
-      VRAM_WIDTH,
-      VRAM_HEIGHT,
-      gl.RGBA,
-      gl.UNSIGNED_BYTE,
-      context.system.state.buffers.framebuffer,
-    );
+    // The core only converts a frame once, and reports which rows changed
+    const changed = context.system.getFrame();
+    const rows = uploaded ? changed : ALL_ROWS;
+
+    if (rows) {
+      gl.bindTexture(gl.TEXTURE_2D, tex);
+    }
+
+    // Upload each run of changed rows in one call
+    for (let y = 0; y < VRAM_HEIGHT; ) {
+      if (!((rows >> BigInt(y)) & 1n)) {
+        y++;
+        continue;
+      }
+
+      let end = y + 1;
+      while (end < VRAM_HEIGHT && (rows >> BigInt(end)) & 1n) {
+        end++;
+      }
+
+      gl.texSubImage2D(
+        gl.TEXTURE_2D,
+        0,
+        0,
+        y,
+        VRAM_WIDTH,
+        end - y,
+        gl.RGBA,
+        gl.UNSIGNED_BYTE,
+        context.system.state.buffers.framebuffer,
+        y * VRAM_WIDTH * 4,
+      );
+      y = end;
+    }
+
+    uploaded = true;
 
     gl.clearColor(
       context.system.clearColor.r,
@@ -0,0 +1,70 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Machine
+{
+  struct State;
+};
+
+namespace Analysis
+{
+  static const int ADDRESS_SPACE = 0x200000;
+  static const int STACK_DEPTH = 4096;
+
+  // The cartridge header holds a 6 byte jump slot for reset and each IRQ
+  static const uint32_t CART_ENTRY = 0x2102;
+  static const int CART_ENTRY_SLOTS = 27;
+  static const int CART_ENTRY_STRIDE = 6;
+
+  enum Attribute : uint8_t
+  {
+    ATTR_CODE = 1,      // First byte of an instruction
+    ATTR_OPERAND = 2,   // Any later byte of an instruction
+    ATTR_BRANCH = 4,    // Jump destination
+    ATTR_CALL = 8,      // Subroutine entry
+    ATTR_ENTRY = 16,    // Hardware vector destination or cartridge jump slot
+    ATTR_VECTOR = 32,   // Byte of the BIOS vector table
+    ATTR_CONFLICT = 64, // Decoding from here overlaps code or is not an instruction
+    ATTR_PENDING = 128  // Destination that did not fit on the work stack
+  };
+
+  struct Work
+  {
+    uint32_t address;
+    int32_t bank; // NB in effect on arrival, Disassembler::BANK_UNKNOWN if not known
+  };
+
+  struct State
+  {
+    // Totals from the last pass
+    uint32_t instructions;
+    uint32_t targets;
+    uint32_t unresolved; // Branches through registers or memory
+    uint32_t conflicts;
+
+    uint32_t depth;
+    bool overflowed;
+    Work stack[STACK_DEPTH];
+
+    uint8_t map[ADDRESS_SPACE]; // Attribute bits per physical address
+  };
+}
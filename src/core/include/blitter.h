@@ -63,6 +63,50 @@ namespace Blitter
     uint8_t divider;
   };
 
+  // A sprite tile as drawn for one pair of flip flags, per column
+  struct Sprite
+  {
+    uint32_t address;    // Graphics it was decoded from
+    uint32_t generation; // Of the memory holding them, when decoded
+    bool valid;
+
+    uint16_t cover[16];  // Pixels the sprite hides
+    uint16_t ink[2][16]; // Pixels it sets, plain and inverted
+  };
+
+  // Decoded sprites, by flip flags and then tile
+  struct Cache
+  {
+    Sprite sprites[4][0x100];
+  };
+
+  // What the last frame was drawn from. A frame read wholly from host memory
+  // comes out the same while its registers and every page it read stay put
+  struct Inputs
+  {
+    bool valid;
+    bool cart_enabled;
+    bool invert_map;
+    bool enable_map;
+    bool enable_sprites;
+    uint8_t map_size;
+    uint8_t scroll_x;
+    uint8_t scroll_y;
+    uint32_t map_base;
+    uint32_t sprite_base;
+
+    uint16_t pages;                // RAM pages read, the overlay included
+    uint32_t ram_generation[0x10]; // Taken after the copy back
+    uint32_t rom_generation;
+
+    bool fetched;    // Anything was read at all
+    uint8_t bus_cap; // The last byte read
+
+    bool traced;               // The trace saw the reads
+    uint64_t trace_banks;      // Trace banks holding what was read
+    uint32_t trace_generation; // Taken once the reads were traced
+  };
+
   void reset(Machine::State &cpu);
   void clock(Machine::State &cpu);
   uint8_t read(Machine::State &cpu, uint32_t address);
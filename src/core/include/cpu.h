@@ -0,0 +1,73 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace CPU
+{
+  struct State
+  {
+    struct
+    {
+      bool z;
+      bool c;
+      bool v;
+      bool n;
+      bool d;
+      bool u;
+      uint8_t i;
+
+      bool f0;
+      bool f1;
+      bool f2;
+      bool f3;
+    } flag;
+
+    union
+    {
+      struct
+      {
+        uint8_t a;
+        uint8_t b;
+        uint8_t l;
+        uint8_t h;
+      };
+
+      struct
+      {
+        uint16_t ba;
+        uint16_t hl;
+      };
+    };
+
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t ix;
+    uint16_t iy;
+
+    uint8_t br;
+    uint8_t ep;
+    uint8_t xp;
+    uint8_t yp;
+
+    uint8_t cb;
+    uint8_t nb;
+  };
+};
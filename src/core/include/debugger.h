@@ -0,0 +1,185 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Machine
+{
+  struct State;
+};
+
+namespace Debugger
+{
+  static const int ADDRESS_SPACE = 0x200000;
+  static const int WATCHPOINT_COUNT = 16;
+  static const int WATCH_PAGE_BITS = 8;
+  static const int CONDITION_COUNT = 32;
+  static const int PROGRAM_LENGTH = 64;
+  static const int EVAL_STACK_DEPTH = 16;
+  static const int LOG_COUNT = 1024;
+
+  enum StopReason : uint8_t
+  {
+    STOP_NONE,
+    STOP_BREAKPOINT,
+    STOP_WATCHPOINT,
+    STOP_CONDITION,
+    STOP_RECORDER_FULL // The host has to drain the instruction recorder
+  };
+
+  enum ConditionKind : uint8_t
+  {
+    CONDITION_UNUSED,
+    CONDITION_BREAK, // Stops when the program leaves a non-zero value
+    CONDITION_LOG    // Never stops, LOG instructions append to the log ring
+  };
+
+  // Condition bytecode, a stack machine over signed 32-bit values
+  enum Opcode : uint8_t
+  {
+    OP_END,   // Result is the top of the stack, or 0 when empty
+    OP_PUSH,  // imm32 (little endian)
+    OP_REG,   // imm8 Register
+    OP_HITS,  // Times this condition has been reached, including now
+    OP_READ8, // Side-effect free reads of a physical address
+    OP_READ16,
+    OP_ADD,
+    OP_SUB,
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_SHL,
+    OP_SHR,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_LAND,
+    OP_LOR,
+    OP_NOT,
+    OP_NEG,
+    OP_JZ, // imm8 forward offset, pops the condition
+    OP_LOG // Pops a value into the log ring
+  };
+
+  enum Register : uint8_t
+  {
+    REG_A,
+    REG_B,
+    REG_L,
+    REG_H,
+    REG_BA,
+    REG_HL,
+    REG_IX,
+    REG_IY,
+    REG_SP,
+    REG_PC,
+    REG_BR,
+    REG_EP,
+    REG_XP,
+    REG_YP,
+    REG_NB,
+    REG_CB,
+    REG_SC,
+    REG_PHYSICAL_PC
+  };
+
+  struct Condition
+  {
+    ConditionKind kind;
+    uint32_t address;
+    uint32_t hits;
+    uint8_t program[PROGRAM_LENGTH];
+  };
+
+  struct LogEntry
+  {
+    uint32_t address;   // Physical PC of the logpoint
+    uint16_t condition; // Slot that produced the value
+    uint16_t item;      // Position in the logpoint's expression list
+    int32_t value;
+  };
+
+  enum WatchKind : uint8_t
+  {
+    WATCH_READ = 1,
+    WATCH_WRITE = 2,
+    WATCH_EXECUTE = 4
+  };
+
+  struct Watchpoint
+  {
+    uint32_t start; // Inclusive physical range
+    uint32_t end;
+    uint8_t kinds; // WatchKind mask, 0 when unused
+  };
+
+  struct State
+  {
+    // The next check does not stop at resume_address, so execution can
+    // continue from a breakpoint or a host step that landed on one
+    bool skip;
+    uint32_t resume_address;
+
+    StopReason stop_reason;
+    uint32_t stop_address;
+    int32_t stop_watchpoint;
+    int32_t stop_condition;
+    uint8_t stop_kind;    // WatchKind of the access that hit
+    uint32_t stop_access; // TraceType flags of the access, 0 for execution
+    uint8_t stop_value;
+
+    // cpu_advance only checks the PC while this is set
+    bool armed;
+
+    uint32_t breakpoint_count;
+    uint8_t breakpoints[ADDRESS_SPACE / 8];
+
+    // Memory accesses only take the slow path while this is set, and then
+    // only for pages that have a watchpoint on them
+    bool watching;
+    uint8_t watch_kinds;
+    Watchpoint watchpoints[WATCHPOINT_COUNT];
+    uint8_t watch_pages[ADDRESS_SPACE >> WATCH_PAGE_BITS];
+
+    // Conditional breakpoints and logpoints, the host compiles into
+    // program_buffer before calling condition_set
+    uint32_t condition_count;
+    bool condition_error; // A program ran off its end or its stack
+    Condition conditions[CONDITION_COUNT];
+    uint8_t condition_pages[ADDRESS_SPACE >> WATCH_PAGE_BITS];
+    uint8_t program_buffer[PROGRAM_LENGTH];
+
+    // log_index counts every value ever logged
+    uint32_t log_index;
+    LogEntry log[LOG_COUNT];
+  };
+
+  void reset(Machine::State &cpu);
+  void resume_at(Machine::State &cpu, uint32_t address);
+  bool break_at(Machine::State &cpu, uint32_t address);
+  bool evaluate(Machine::State &cpu, uint32_t address);
+  void watch(Machine::State &cpu, uint32_t address, uint32_t access, uint8_t value);
+
+  // Reads a physical address without bus or register side effects
+  uint8_t peek8(Machine::State &cpu, uint32_t address);
+}
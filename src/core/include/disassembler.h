@@ -0,0 +1,72 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Machine
+{
+  struct State;
+};
+
+namespace Disassembler
+{
+  static const uint32_t NO_TARGET = 0xFFFFFFFF;
+  static const int BANK_UNKNOWN = -1;
+  static const int BUFFER_RECORDS = 1024; // Size of the host's output buffer
+
+  enum RecordFlags : uint8_t
+  {
+    RECORD_UNDEFINED = 1, // No instruction decodes here, length covers the bytes examined
+    RECORD_BRANCH = 2,    // Transfers control somewhere, target is set when it can be resolved
+    RECORD_CALL = 4,      // Execution resumes after the instruction once the callee returns
+    RECORD_RETURN = 8,
+    RECORD_STOP = 16,     // Never continues with the next instruction
+    RECORD_SETS_BANK = 32 // Writes NB, later branches use the loaded bank
+  };
+
+  // Exported as-is, see tools/opcodes.py for the operation, condition and
+  // argument numbering (shared with instructions.ts)
+  struct Record
+  {
+    uint32_t address; // Physical address of the first byte
+    uint32_t target;  // Physical branch destination, NO_TARGET when unknown
+    uint16_t opcode;  // Table << 8 | code, the numbering used by the opcode profiler
+    uint16_t operands[2]; // Decoded argument values, displacements sign extended
+    uint8_t length;
+    uint8_t operation;
+    uint8_t condition;
+    uint8_t flags;     // RecordFlags
+    uint8_t arguments[2];
+  };
+
+  static_assert(sizeof(Record) == 20, "Record layout is shared with the host");
+
+  // NB is assumed to match the bank code runs from, which is only known
+  // for code inside the banked window
+  int default_bank(uint32_t address);
+
+  // Decodes one instruction without side effects. Branches into the banked
+  // window resolve through bank (the NB in effect) and stay unresolved when
+  // it is BANK_UNKNOWN
+  void decode(Machine::State &cpu, uint32_t address, int bank, Record &record);
+
+  // NB in effect for the instruction that follows record in memory
+  int next_bank(const Record &record, int bank);
+}
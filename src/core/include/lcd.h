@@ -27,6 +27,26 @@ static const int LCD_HEIGHT = 64;
 
 namespace LCD
 {
+  static const int HISTORY_FRAMES = 8;
+  static const int ROW_BYTES = LCD_WIDTH / 8;
+
+  // Pixel persistence, one bit plane per frame. Plane head[y] of a row is
+  // the newest scan and the planes that follow it are progressively older
+  struct History
+  {
+    uint8_t planes[LCD_HEIGHT][HISTORY_FRAMES][ROW_BYTES];
+    uint8_t head[LCD_HEIGHT];
+  };
+
+  // Rows are top to bottom and pixels left to right in every format
+  enum FrameFormat : int
+  {
+    FRAME_RGBA32,     // 4 bytes a pixel, through the palette
+    FRAME_1BPP,       // Newest scan of each row, pixel x in bit x % 8 of byte x / 8
+    FRAME_INTENSITY8, // Ghosted and contrast adjusted level, before the palette
+    FRAME_RGB565      // 2 bytes a pixel, through the palette
+  };
+
   struct State
   {
     uint8_t gddram[9][132];
@@ -48,14 +68,44 @@ namespace LCD
     uint8_t resistor_ratio;
     uint8_t operating_mode;
     uint8_t scanline;
+    uint8_t frame_volume; // Contrast latched at the last frame end
+
+    // Change counts of the display pages, also bumped by any display control
+    // change. A row that has scanned the same source HISTORY_FRAMES times
+    // has converged and is not rendered again until its source moves
+    uint32_t page_changes[8];
+    uint32_t row_changes[LCD_HEIGHT];
+    uint8_t row_page[LCD_HEIGHT];
+    uint8_t row_repeats[LCD_HEIGHT];
 
     int32_t overflow;
   };
 
+  // The last completed frame, converted only when the host asks for it
+  struct Frame
+  {
+    History history;
+    uint32_t sequence;  // Frames completed
+    uint32_t converted; // Sequence the framebuffer was built from
+    uint8_t volume;     // Contrast the frame is shown at
+  };
+
+  // Shade history value to framebuffer colour, for one contrast setting
+  struct Colors
+  {
+    uint32_t lut[0x100];
+    uint16_t rgb565[0x100];
+    uint8_t intensity[0x100];
+    uint8_t volume;
+    bool valid;
+  };
+
   void reset(LCD::State &lcd);
 
   uint8_t get_scanline(LCD::State &lcd);
   void clock(Machine::State &cpu, int osc1);
   uint8_t read(LCD::State &lcd, uint32_t address);
+  uint8_t peek(const LCD::State &lcd, uint32_t address);
   void write(LCD::State &lcd, uint8_t data, uint32_t address);
+  void write_page_block(LCD::State &lcd, uint8_t page, const uint8_t *data, int length);
 }
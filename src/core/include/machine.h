@@ -27,6 +27,7 @@ namespace Machine
 };
 
 #include "lcd.h"
+#include "cpu.h"
 #include "irq.h"
 #include "tim256.h"
 #include "timers.h"
@@ -38,66 +39,23 @@ namespace Machine
 #include "gpio.h"
 #include "audio.h"
 #include "tracing.h"
+#include "profile.h"
+#include "stats.h"
+#include "debugger.h"
+#include "rewind.h"
+#include "disassembler.h"
+#include "analysis.h"
+#include "recorder.h"
 
 const auto OSC1_SPEED = 32768;
 const auto OSC3_SPEED = 4000000;
 const auto TICK_SPEED = 1000;
 const auto CPU_SPEED = 1000000;
 
-namespace CPU
-{
-  struct State
-  {
-    struct
-    {
-      bool z;
-      bool c;
-      bool v;
-      bool n;
-      bool d;
-      bool u;
-      uint8_t i;
-
-      bool f0;
-      bool f1;
-      bool f2;
-      bool f3;
-    } flag;
-
-    union
-    {
-      struct
-      {
-        uint8_t a;
-        uint8_t b;
-        uint8_t l;
-        uint8_t h;
-      };
-
-      struct
-      {
-        uint16_t ba;
-        uint16_t hl;
-      };
-    };
-
-    uint16_t pc;
-    uint16_t sp;
-    uint16_t ix;
-    uint16_t iy;
-
-    uint8_t br;
-    uint8_t ep;
-    uint8_t xp;
-    uint8_t yp;
-
-    uint8_t cb;
-    uint8_t nb;
-  };
-};
-
 namespace Machine
 {
+  static const int TRANSFER_SIZE = 0x10000;
+
   enum Status : uint8_t
   {
     STATUS_NORMAL,
@@ -114,10 +72,14 @@ namespace Machine
 
     // Runtime interface buffers
     float audio[AUDIO_BUFFER_LENGTH];
-    uint8_t lcd_shift[LCD_HEIGHT][LCD_WIDTH];
+    LCD::History lcd_history;
     uint32_t framebuffer[LCD_HEIGHT][LCD_WIDTH];
     uint32_t palette[0x100];
     float weights[0x100];
+    Disassembler::Record disassembly[Disassembler::BUFFER_RECORDS];
+
+    // Host side staging for peek_block and poke_block
+    uint8_t transfer[TRANSFER_SIZE];
   };
 
   struct State
@@ -125,6 +87,8 @@ namespace Machine
     CPU::State reg;
     IRQ::State irq;
     LCD::State lcd;
+    LCD::Colors colors;
+    LCD::Frame frame;
     RTC::State rtc;
     Control::State ctrl;
     TIM256::State tim256;
@@ -133,12 +97,30 @@ namespace Machine
     Input::State input;
     GPIO::State gpio;
     Audio::State audio;
+    Profile::State profile;
+    Stats::Counters stats;
+    Debugger::State debugger;
+    Rewind::State rewind;
+    Analysis::State analysis;
+    Trace::State trace;
+    Recorder::State recorder;
+
+    // Bumped on writes into each 256 byte page of RAM and on any host change
+    // to the BIOS or cartridge, so decoded graphics know when to go stale
+    uint32_t ram_generation[0x10];
+    uint32_t rom_generation;
+    Blitter::Cache sprite_cache;
+    Blitter::Inputs blitter_inputs;
 
     uint8_t bus_cap;
     int clocks;
     int osc1_overflow;
     Status status;
 
+#ifdef PROFILE_OPCODES
+    Profile::Opcodes opcodes;
+#endif
+
     union
     {
       uint8_t ram[0x1000];
@@ -156,21 +138,49 @@ extern "C" uint8_t cpu_read(Machine::State &cpu, uint32_t address);
 extern "C" void cpu_write(Machine::State &cpu, uint8_t data, uint32_t address);
 
 extern "C" void cpu_step(Machine::State &cpu);
-extern "C" void cpu_advance(Machine::State &cpu, int ticks);
+extern "C" Debugger::StopReason cpu_advance(Machine::State &cpu, int ticks);
 
 // Bridge functions
 extern "C" void cpu_initialize(Machine::State &cpu);
 extern "C" void cpu_reset(Machine::State &cpu);
-extern "C" void cpu_advance(Machine::State &cpu, int ticks);
+extern "C" Debugger::StopReason cpu_advance(Machine::State &cpu, int ticks);
 extern "C" void set_sample_rate(Machine::State &cpu, int rate);
 extern "C" void update_inputs(Machine::State &cpu, uint16_t value);
+extern "C" void set_sampling(Machine::State &cpu, int interval);
+extern "C" void palette_changed(Machine::State &cpu);
+extern "C" void cartridge_changed(Machine::State &cpu);
+extern "C" uint64_t get_frame(Machine::State &cpu, LCD::FrameFormat format);
+extern "C" uint32_t read_frame(Machine::State &cpu, LCD::FrameFormat format, uint8_t *target);
+extern "C" void set_callgraph(Machine::State &cpu, bool enabled);
+extern "C" const Stats::Counters *get_stats(Machine::State &cpu);
+extern "C" void breakpoint_set(Machine::State &cpu, uint32_t address);
+extern "C" void breakpoint_clear(Machine::State &cpu, uint32_t address);
+extern "C" int watchpoint_set(Machine::State &cpu, uint32_t start, uint32_t end, uint8_t kinds);
+extern "C" void watchpoint_clear(Machine::State &cpu, int index);
+extern "C" int condition_set(Machine::State &cpu, uint32_t address, uint8_t kind);
+extern "C" void condition_clear(Machine::State &cpu, int slot);
+extern "C" void rewind_enable(Machine::State &cpu, uint32_t interval);
+extern "C" bool cpu_step_back(Machine::State &cpu);
+extern "C" bool cpu_reverse_step_over(Machine::State &cpu);
+extern "C" Debugger::StopReason cpu_reverse_continue(Machine::State &cpu);
+extern "C" uint32_t analyze_code(Machine::State &cpu);
+extern "C" void trace_enable(Machine::State &cpu, bool enabled);
+extern "C" void trace_reset(Machine::State &cpu);
+extern "C" void trace_set(Machine::State &cpu, uint32_t address, uint8_t attributes);
+extern "C" uint64_t trace_changed_banks(Machine::State &cpu, uint32_t since);
+extern "C" void recorder_enable(Machine::State &cpu, bool enabled);
+extern "C" void peek_block(Machine::State &cpu, uint32_t address, uint32_t length, uint8_t *out);
+extern "C" void poke_block(Machine::State &cpu, uint32_t address, uint32_t length, const uint8_t *in);
+extern "C" uint32_t disassemble(Machine::State &cpu, uint32_t address, uint32_t count, Disassembler::Record *out);
 extern "C" const char *get_version();
 
 // Clock management
 void cpu_clock(Machine::State &cpu, int cycles);
+void cpu_execute(Machine::State &cpu);
 int inst_advance(Machine::State &cpu);
 
 // These are memory access helpers
+uint8_t cpu_peek(Machine::State &cpu, uint32_t address);
 uint8_t cpu_readSC(Machine::State &cpu);
 void cpu_writeSC(Machine::State &cpu, uint8_t data);
 
@@ -198,3 +208,30 @@ static inline uint32_t calc_pc(Machine::State &cpu)
     return address;
   }
 }
+
+// Calls and returns only reach the profiler while it runs
+static inline void profile_enter(Machine::State &cpu, uint32_t site)
+{
+  if (cpu.profile.active)
+  {
+    Profile::enter(cpu.profile, cpu.reg.sp, calc_pc(cpu), site);
+  }
+}
+
+static inline void profile_leave(Machine::State &cpu)
+{
+  if (cpu.profile.active)
+  {
+    Profile::leave(cpu.profile, cpu.reg.sp);
+  }
+}
+
+// Every access the debugger's trace keeps goes through here
+static inline void cpu_trace(Machine::State &cpu, uint32_t address, uint32_t kind)
+{
+  if (cpu.trace.enabled)
+  {
+    cpu.stats.trace_events++;
+    Trace::record(cpu.trace, address, kind);
+  }
+}
@@ -0,0 +1,172 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Machine
+{
+  struct State;
+};
+
+namespace Profile
+{
+  static const int STACK_DEPTH = 32;
+  static const int SAMPLE_DEPTH = 16;
+  static const int SAMPLE_COUNT = 4096;
+  static const int EDGE_COUNT = 4096;
+  static const int EDGE_SLOTS = EDGE_COUNT * 2; // Power of two
+
+  // Base table, then the 0xCE and 0xCF extended tables
+  static const int OPCODE_TABLES = 3;
+  static const int TOTAL_OPCODES = OPCODE_TABLES * 0x100;
+
+  // Only present in builds with PROFILE_OPCODES defined
+  struct Opcodes
+  {
+    uint64_t executions[TOTAL_OPCODES];
+    uint64_t cycles[TOTAL_OPCODES];
+
+    // Cycles already attributed to an instruction executed inline by the current one
+    int chained_cycles;
+  };
+
+  struct Frame
+  {
+    uint32_t target; // Physical address of the routine that was entered
+    uint16_t sp;     // Stack pointer once the return address was pushed
+    int16_t edge;    // Call graph edge, -1 when not recorded
+    uint64_t start;  // Cycle count on entry
+    uint64_t nested; // Inclusive cycles of completed callees
+  };
+
+  // Exported as-is, edges[0..edge_count) is the call graph table
+  struct Edge
+  {
+    uint32_t site;   // Physical return address of the call (interrupted PC for IRQs)
+    uint32_t target; // Physical address of the callee
+    uint32_t calls;
+    uint32_t reserved;
+    uint64_t inclusive;
+    uint64_t exclusive;
+  };
+
+  struct Sample
+  {
+    uint32_t pc;
+    uint32_t depth; // Shadow stack depth, may be larger than SAMPLE_DEPTH
+    uint32_t frames[SAMPLE_DEPTH];
+  };
+
+  struct State
+  {
+    bool active; // Either the sampler or the call graph is running
+    bool sampling;
+    bool callgraph;
+    int32_t interval;
+    int32_t countdown;
+
+    // Shadow call stack, innermost frame last
+    uint32_t depth;
+    Frame stack[STACK_DEPTH];
+
+    // Ring of samples, write_index counts every sample ever taken
+    uint32_t write_index;
+    Sample samples[SAMPLE_COUNT];
+
+    // Call graph, edges are appended in first-call order
+    uint64_t cycles;
+    uint32_t edge_count;
+    uint32_t edges_dropped;
+    int16_t edge_slots[EDGE_SLOTS];
+    Edge edges[EDGE_COUNT];
+  };
+
+  void reset(Machine::State &cpu);
+  void sample(Machine::State &cpu);
+  int16_t find_edge(Profile::State &profile, uint32_t site, uint32_t target);
+  void drop_outermost(Profile::State &profile);
+
+  /**
+   * Shadow call stack
+   *
+   * Frames remember the stack pointer they were entered with, so a return
+   * unwinds every frame at or above the current stack pointer. Games that
+   * discard return addresses by hand are resynchronized at the next call
+   * or return, and the abandoned frames are closed at that point.
+   **/
+
+  static inline void unwind(Profile::State &profile, uint16_t sp)
+  {
+    while (profile.depth > 0 && profile.stack[profile.depth - 1].sp <= sp)
+    {
+      const Profile::Frame &frame = profile.stack[--profile.depth];
+      uint64_t inclusive = profile.cycles - frame.start;
+
+      if (frame.edge >= 0)
+      {
+        Profile::Edge &edge = profile.edges[frame.edge];
+
+        edge.inclusive += inclusive;
+        edge.exclusive += inclusive - frame.nested;
+      }
+
+      if (profile.depth > 0)
+      {
+        profile.stack[profile.depth - 1].nested += inclusive;
+      }
+    }
+  }
+
+  // A call into target from site, with the return address already pushed
+  static inline void enter(Profile::State &profile, uint16_t sp, uint32_t target, uint32_t site)
+  {
+    unwind(profile, sp);
+
+    if (profile.depth >= STACK_DEPTH)
+    {
+      drop_outermost(profile);
+    }
+
+    Frame &frame = profile.stack[profile.depth++];
+    frame.target = target;
+    frame.sp = sp;
+    frame.start = profile.cycles;
+    frame.nested = 0;
+    frame.edge = -1;
+
+    if (profile.callgraph && (frame.edge = find_edge(profile, site, target)) >= 0)
+    {
+      profile.edges[frame.edge].calls++;
+    }
+  }
+
+  static inline void leave(Profile::State &profile, uint16_t sp)
+  {
+    unwind(profile, sp);
+  }
+
+  // Runs for every instruction while profiling, true once a sample is due
+  static inline bool clock(Profile::State &profile, int cycles)
+  {
+    profile.cycles += cycles;
+
+    return profile.sampling && (profile.countdown -= cycles) <= 0;
+  }
+}
@@ -0,0 +1,83 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Machine
+{
+  struct State;
+};
+
+namespace Recorder
+{
+  static const int RING_BITS = 15;
+  static const uint32_t RING_SIZE = 1 << RING_BITS;
+
+  // cpu_advance stops while fewer slots than this are free, instructions
+  // that block IRQs execute the next one without returning to the loop
+  static const uint32_t HEADROOM = 64;
+
+  // One executed instruction, registers are as it found them
+  struct Entry
+  {
+    uint64_t cycle;   // CPU cycles completed before it
+    uint32_t address; // Physical PC
+    uint8_t bytes[4]; // Code at the PC, the instruction may be shorter
+
+    uint16_t pc;
+    uint16_t ba;
+    uint16_t hl;
+    uint16_t ix;
+    uint16_t iy;
+    uint16_t sp;
+
+    uint8_t br;
+    uint8_t ep;
+    uint8_t xp;
+    uint8_t yp;
+    uint8_t nb;
+    uint8_t cb;
+    uint8_t sc;
+    uint8_t reserved;
+  };
+
+  // Single producer ring, the core only writes head and the host only
+  // writes tail, so a host thread can drain it while the core runs
+  struct State
+  {
+    bool enabled;
+    uint32_t head;    // Entries ever recorded
+    uint32_t tail;    // Entries the host has consumed
+    uint32_t dropped; // Entries lost to a full ring
+    Entry ring[RING_SIZE];
+  };
+
+  void record(Machine::State &cpu);
+
+  static inline uint32_t pending(const State &recorder)
+  {
+    return recorder.head - __atomic_load_n(&recorder.tail, __ATOMIC_ACQUIRE);
+  }
+
+  static inline bool full(const State &recorder)
+  {
+    return pending(recorder) > RING_SIZE - HEADROOM;
+  }
+}
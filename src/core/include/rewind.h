@@ -0,0 +1,101 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "irq.h"
+#include "lcd.h"
+#include "rtc.h"
+#include "control.h"
+#include "tim256.h"
+#include "blitter.h"
+#include "timers.h"
+#include "input.h"
+#include "gpio.h"
+#include "audio.h"
+#include "debugger.h"
+
+namespace Machine
+{
+  struct State;
+};
+
+namespace Rewind
+{
+  static const int KEYFRAME_COUNT = 32;
+  static const int INPUT_COUNT = 1024;
+
+  // Everything execution depends on, the cartridge is assumed not to change
+  struct Snapshot
+  {
+    uint64_t position;
+
+    CPU::State reg;
+    IRQ::State irq;
+    LCD::State lcd;
+    RTC::State rtc;
+    Control::State ctrl;
+    TIM256::State tim256;
+    Blitter::State blitter;
+    Timers::State timers;
+    Input::State input;
+    GPIO::State gpio;
+    Audio::State audio;
+
+    uint8_t bus_cap;
+    int osc1_overflow;
+    uint8_t status;
+
+    uint8_t ram[0x1000];
+    LCD::History lcd_history;
+
+    // Hit counts are part of history, so conditions replay faithfully
+    uint32_t condition_hits[Debugger::CONDITION_COUNT];
+  };
+
+  struct InputEvent
+  {
+    uint64_t position;
+    uint16_t value;
+  };
+
+  struct State
+  {
+    bool recording;
+    bool replaying;
+    uint32_t interval; // Steps between keyframes
+
+    // Steps executed, one per instruction or idle cycle
+    uint64_t position;
+    uint64_t next_keyframe;
+
+    // Both count every entry ever written to their ring
+    uint32_t keyframe_index;
+    uint32_t input_index;
+
+    InputEvent inputs[INPUT_COUNT];
+    Snapshot keyframes[KEYFRAME_COUNT];
+  };
+
+  void reset(Machine::State &cpu);
+  void capture(Machine::State &cpu);
+  void input(Machine::State &cpu, uint16_t value);
+}
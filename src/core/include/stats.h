@@ -0,0 +1,83 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "irq.h"
+
+namespace Stats
+{
+  enum Subsystem
+  {
+    HOST_CPU,
+    HOST_LCD,
+    HOST_BLITTER,
+    HOST_TIMERS,
+    HOST_AUDIO,
+    TOTAL_SUBSYSTEMS
+  };
+
+  // Monotonic, never cleared by a reset
+  struct Counters
+  {
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t halted_cycles;
+    uint64_t sleeping_cycles;
+    uint64_t clock_calls;
+    uint64_t scanlines;
+    uint64_t frames;
+    uint64_t blitter_frames;
+    uint64_t irqs[IRQ::TOTAL_HARDWARE_IRQS];
+    uint64_t audio_samples;
+    uint64_t trace_events;
+
+    // Wall clock time per subsystem, only measured by builds with STATS_TIMING
+    uint64_t host_ns[TOTAL_SUBSYSTEMS];
+  };
+
+#ifdef STATS_TIMING
+  extern "C" uint64_t host_time_ns();
+
+  // Charges the lifetime of the scope to a subsystem
+  struct Timer
+  {
+    uint64_t &counter;
+    uint64_t start;
+
+    Timer(Counters &stats, Subsystem subsystem)
+        : counter(stats.host_ns[subsystem]), start(host_time_ns())
+    {
+    }
+
+    ~Timer()
+    {
+      counter += host_time_ns() - start;
+    }
+  };
+#else
+  struct Timer
+  {
+    Timer(Counters &stats, Subsystem subsystem)
+    {
+    }
+  };
+#endif
+}
@@ -18,6 +18,8 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #pragma once
 
+#include <stdint.h>
+
 #define BIT(n) (1u << n)
 
 enum TraceType : uint32_t
@@ -48,4 +50,81 @@ enum TraceType : uint32_t
   TRACE_WRITE = BIT(31)
 };
 
-extern "C" void trace_access(Machine::State &cpu, uint32_t address, uint32_t kind);
+namespace Trace
+{
+  static const int ADDRESS_SPACE = 0x200000;
+  static const int BANK_BITS = 15;
+  static const int BANK_COUNT = ADDRESS_SPACE >> BANK_BITS;
+
+  // What the debugger keeps of each access, packed into a byte per address
+  enum Attribute : uint8_t
+  {
+    ATTR_NONE = 0,
+    ATTR_WORD_LO = BIT(0),
+    ATTR_DATA = BIT(1),
+    ATTR_INSTRUCTION = BIT(2),
+    ATTR_STACK = BIT(3),
+    ATTR_VECTOR = BIT(4),
+    ATTR_BRANCH_TARGET = BIT(5),
+    ATTR_RETURN_ADDRESS = BIT(6),
+    ATTR_GRAPHICS = BIT(7) // Tile or sprite data read by the blitter
+  };
+
+  struct State
+  {
+    bool enabled;
+
+    // generation counts every attribute change, each bank remembers its latest
+    uint32_t generation;
+    uint32_t bank_generation[BANK_COUNT];
+
+    uint8_t attributes[ADDRESS_SPACE];
+  };
+
+  static inline uint8_t pack(uint32_t kind)
+  {
+    return ((kind & TRACE_WORD_LO) ? ATTR_WORD_LO : 0) |
+           ((kind & TRACE_DATA) ? ATTR_DATA : 0) |
+           ((kind & TRACE_INSTRUCTION) ? ATTR_INSTRUCTION : 0) |
+           ((kind & TRACE_STACK) ? ATTR_STACK : 0) |
+           ((kind & TRACE_VECTOR) ? ATTR_VECTOR : 0) |
+           ((kind & TRACE_BRANCH_TARGET) ? ATTR_BRANCH_TARGET : 0) |
+           ((kind & TRACE_RETURN_ADDRESS) ? ATTR_RETURN_ADDRESS : 0) |
+           ((kind & (TRACE_TILE_DATA | TRACE_SPRITE_DATA)) ? ATTR_GRAPHICS : 0);
+  }
+
+  static inline void set(State &trace, uint32_t address, uint8_t value)
+  {
+    uint8_t &attributes = trace.attributes[address];
+
+    if (attributes != value)
+    {
+      attributes = value;
+      trace.bank_generation[address >> BANK_BITS] = ++trace.generation;
+    }
+  }
+
+  // Reads accumulate, writes to RAM replace what was known about the byte
+  static inline void record(State &trace, uint32_t address, uint32_t kind)
+  {
+    address &= ADDRESS_SPACE - 1;
+
+    // Registers are not memory
+    if (address >= 0x2000 && address <= 0x20FF)
+    {
+      return;
+    }
+
+    if (kind & TRACE_WRITE)
+    {
+      if (address < 0x2100)
+      {
+        set(trace, address, pack(kind));
+      }
+    }
+    else
+    {
+      set(trace, address, trace.attributes[address] | pack(kind));
+    }
+  }
+}
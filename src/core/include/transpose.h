@@ -0,0 +1,154 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+/**
+ * 8x8 bit and byte matrix transposes
+ *
+ * The LCD and the blitter both keep pixels as columns of bytes and need
+ * them as rows, or the other way around. The byte transpose uses the vector
+ * unit where the target has one.
+ **/
+
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// Swap bit c of byte r with bit r of byte c
+static inline uint64_t transpose_bits(uint64_t x)
+{
+  uint64_t t;
+
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+  x ^= t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+  x ^= t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+  x ^= t ^ (t << 28);
+
+  return x;
+}
+
+// Swap byte c of rows[r] with byte r of rows[c]
+#if defined(__SSE2__)
+
+static inline void transpose8x8(uint64_t *rows)
+{
+  __m128i *pairs = (__m128i *)rows;
+
+  __m128i r01 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)&rows[0]), _mm_loadl_epi64((__m128i *)&rows[1]));
+  __m128i r23 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)&rows[2]), _mm_loadl_epi64((__m128i *)&rows[3]));
+  __m128i r45 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)&rows[4]), _mm_loadl_epi64((__m128i *)&rows[5]));
+  __m128i r67 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)&rows[6]), _mm_loadl_epi64((__m128i *)&rows[7]));
+
+  __m128i q0 = _mm_unpacklo_epi16(r01, r23);
+  __m128i q1 = _mm_unpackhi_epi16(r01, r23);
+  __m128i q2 = _mm_unpacklo_epi16(r45, r67);
+  __m128i q3 = _mm_unpackhi_epi16(r45, r67);
+
+  _mm_storeu_si128(pairs + 0, _mm_unpacklo_epi32(q0, q2));
+  _mm_storeu_si128(pairs + 1, _mm_unpackhi_epi32(q0, q2));
+  _mm_storeu_si128(pairs + 2, _mm_unpacklo_epi32(q1, q3));
+  _mm_storeu_si128(pairs + 3, _mm_unpackhi_epi32(q1, q3));
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+static inline void transpose8x8(uint64_t *rows)
+{
+  uint8_t *bytes = (uint8_t *)rows;
+
+  uint8x8x2_t z01 = vzip_u8(vld1_u8(bytes + 0), vld1_u8(bytes + 8));
+  uint8x8x2_t z23 = vzip_u8(vld1_u8(bytes + 16), vld1_u8(bytes + 24));
+  uint8x8x2_t z45 = vzip_u8(vld1_u8(bytes + 32), vld1_u8(bytes + 40));
+  uint8x8x2_t z67 = vzip_u8(vld1_u8(bytes + 48), vld1_u8(bytes + 56));
+
+  uint16x8_t r01 = vreinterpretq_u16_u8(vcombine_u8(z01.val[0], z01.val[1]));
+  uint16x8_t r23 = vreinterpretq_u16_u8(vcombine_u8(z23.val[0], z23.val[1]));
+  uint16x8_t r45 = vreinterpretq_u16_u8(vcombine_u8(z45.val[0], z45.val[1]));
+  uint16x8_t r67 = vreinterpretq_u16_u8(vcombine_u8(z67.val[0], z67.val[1]));
+
+  uint32x4_t q0 = vreinterpretq_u32_u16(vzip1q_u16(r01, r23));
+  uint32x4_t q1 = vreinterpretq_u32_u16(vzip2q_u16(r01, r23));
+  uint32x4_t q2 = vreinterpretq_u32_u16(vzip1q_u16(r45, r67));
+  uint32x4_t q3 = vreinterpretq_u32_u16(vzip2q_u16(r45, r67));
+
+  vst1q_u8(bytes + 0, vreinterpretq_u8_u32(vzip1q_u32(q0, q2)));
+  vst1q_u8(bytes + 16, vreinterpretq_u8_u32(vzip2q_u32(q0, q2)));
+  vst1q_u8(bytes + 32, vreinterpretq_u8_u32(vzip1q_u32(q1, q3)));
+  vst1q_u8(bytes + 48, vreinterpretq_u8_u32(vzip2q_u32(q1, q3)));
+}
+
+#elif defined(__wasm_simd128__)
+
+static inline void transpose8x8(uint64_t *rows)
+{
+  v128_t r01 = wasm_i8x16_shuffle(wasm_v128_load64_zero(&rows[0]), wasm_v128_load64_zero(&rows[1]),
+                                  0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+  v128_t r23 = wasm_i8x16_shuffle(wasm_v128_load64_zero(&rows[2]), wasm_v128_load64_zero(&rows[3]),
+                                  0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+  v128_t r45 = wasm_i8x16_shuffle(wasm_v128_load64_zero(&rows[4]), wasm_v128_load64_zero(&rows[5]),
+                                  0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+  v128_t r67 = wasm_i8x16_shuffle(wasm_v128_load64_zero(&rows[6]), wasm_v128_load64_zero(&rows[7]),
+                                  0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+
+  v128_t q0 = wasm_i16x8_shuffle(r01, r23, 0, 8, 1, 9, 2, 10, 3, 11);
+  v128_t q1 = wasm_i16x8_shuffle(r01, r23, 4, 12, 5, 13, 6, 14, 7, 15);
+  v128_t q2 = wasm_i16x8_shuffle(r45, r67, 0, 8, 1, 9, 2, 10, 3, 11);
+  v128_t q3 = wasm_i16x8_shuffle(r45, r67, 4, 12, 5, 13, 6, 14, 7, 15);
+
+  wasm_v128_store(&rows[0], wasm_i32x4_shuffle(q0, q2, 0, 4, 1, 5));
+  wasm_v128_store(&rows[2], wasm_i32x4_shuffle(q0, q2, 2, 6, 3, 7));
+  wasm_v128_store(&rows[4], wasm_i32x4_shuffle(q1, q3, 0, 4, 1, 5));
+  wasm_v128_store(&rows[6], wasm_i32x4_shuffle(q1, q3, 2, 6, 3, 7));
+}
+
+#else
+
+static inline void transpose8x8(uint64_t *rows)
+{
+  static const uint64_t MASKS[] = {0x00FF00FF00FF00FFull, 0x0000FFFF0000FFFFull, 0x00000000FFFFFFFFull};
+
+  for (int stage = 0; stage < 3; stage++)
+  {
+    const int step = 1 << stage;
+    const int shift = 8 << stage;
+    const uint64_t mask = MASKS[stage];
+
+    for (int r = 0; r < 8; r++)
+    {
+      if (r & step)
+        continue;
+
+      uint64_t a = rows[r];
+      uint64_t b = rows[r | step];
+
+      rows[r] = (a & mask) | ((b & mask) << shift);
+      rows[r | step] = ((a >> shift) & mask) | (b & ~mask);
+    }
+  }
+}
+
+#endif
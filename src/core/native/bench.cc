@@ -0,0 +1,723 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+ * Per-subsystem microbenchmarks for the emulation core
+ *
+ * Usage: bench [filter ...]
+ *
+ * Every benchmark whose name contains one of the filters is run (all of them
+ * when no filter is given), and one JSON object per benchmark is written to
+ * stdout so results can be diffed and graphed between builds.
+ **/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <initializer_list>
+
+#include "machine.h"
+
+static const double MIN_SECONDS = 0.25;
+
+static const uint32_t PROGRAM_START = 0x1000;
+static const uint32_t PROGRAM_LIMIT = 0x1600;
+static const uint32_t SUBROUTINE = 0x1F00;
+static const uint32_t CALL_VECTOR = 0x1C00;
+
+static const uint32_t MAP_BASE = 0x10000;
+static const uint32_t SPRITE_BASE = 0x20000;
+
+static const uint8_t GPIO_CLOCK = 0b1000;
+static const uint8_t GPIO_DATA = 0b0100;
+
+static Machine::State machine;
+static uint32_t program_end;
+
+struct Benchmark
+{
+  const char *name;
+  const char *unit;
+  void (*setup)(Machine::State &cpu);
+  int (*run)(Machine::State &cpu);
+};
+
+/**
+ * Shared setup helpers
+ **/
+
+static uint32_t random_state = 0x1234567;
+
+static inline uint8_t random8()
+{
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 16;
+}
+
+static void prepare(Machine::State &cpu)
+{
+  memset(&cpu, 0, sizeof(cpu));
+  cpu_initialize(cpu);
+
+  for (auto &byte : cpu.buffers.cartridge)
+    byte = random8();
+
+  for (int i = 0; i < 0x100; i++)
+  {
+    cpu.buffers.palette[i] = 0xFF000000 | (i * 0x010101);
+    cpu.buffers.weights[i] = __builtin_popcount(i) / 8.0f;
+  }
+
+  palette_changed(cpu);
+
+  // LCD and cartridge bus enabled
+  cpu.ctrl.data[0] = 0b11;
+}
+
+/**
+ * Instruction mixes, executed from RAM
+ **/
+
+struct Emitter
+{
+  Machine::State &cpu;
+  uint32_t pc;
+
+  Emitter(Machine::State &cpu, uint32_t pc) : cpu(cpu), pc(pc) {}
+
+  void op(std::initializer_list<int> bytes)
+  {
+    for (int byte : bytes)
+      cpu.ram[pc++ & 0xFFF] = (uint8_t)byte;
+  }
+
+  // Relative branch offsets are taken from the last byte of the instruction
+  int rel(int length, uint32_t target)
+  {
+    return target - (pc + length) + 1;
+  }
+};
+
+static void prepare_cpu(Machine::State &cpu, void (*pattern)(Emitter &e))
+{
+  prepare(cpu);
+
+  Emitter e(cpu, PROGRAM_START);
+  while (e.pc < PROGRAM_LIMIT)
+    pattern(e);
+  program_end = e.pc;
+
+  cpu.ram[SUBROUTINE & 0xFFF] = 0xF8; // RET
+  cpu.ram[CALL_VECTOR & 0xFFF] = SUBROUTINE & 0xFF;
+  cpu.ram[(CALL_VECTOR + 1) & 0xFFF] = SUBROUTINE >> 8;
+
+  cpu.reg.ep = cpu.reg.xp = cpu.reg.yp = 0;
+  cpu.reg.cb = cpu.reg.nb = 0;
+  cpu.reg.br = 0x1B;
+  cpu.reg.hl = 0x1A04;
+  cpu.reg.ix = 0x1800;
+  cpu.reg.iy = 0x1900;
+  cpu.reg.sp = 0x1E00;
+  cpu.reg.a = 0x12;
+  cpu.reg.b = 0x34;
+}
+
+static int run_cpu(Machine::State &cpu)
+{
+  int count = 0;
+
+  cpu.reg.pc = PROGRAM_START;
+  while (cpu.reg.pc != program_end && cpu.status == Machine::STATUS_NORMAL)
+  {
+    inst_advance(cpu);
+    count++;
+  }
+
+  return count;
+}
+
+static void setup_alu(Machine::State &cpu)
+{
+  prepare_cpu(cpu, [](Emitter &e) {
+    e.op({0x01});       // ADD A, B
+    e.op({0x09});       // ADC A, B
+    e.op({0x11});       // SUB A, B
+    e.op({0x19});       // SBC A, B
+    e.op({0x21});       // AND A, B
+    e.op({0x29});       // OR A, B
+    e.op({0x39});       // XOR A, B
+    e.op({0x31});       // CP A, B
+    e.op({0x02, 0x5A}); // ADD A, #nn
+    e.op({0x80});       // INC A
+    e.op({0x89});       // DEC B
+    e.op({0x90});       // INC BA
+    e.op({0x40 | 8});   // LD B, A
+  });
+}
+
+static void setup_load(Machine::State &cpu)
+{
+  prepare_cpu(cpu, [](Emitter &e) {
+    e.op({0x45});                   // LD A, [HL]
+    e.op({0x46});                   // LD A, [IX]
+    e.op({0x47});                   // LD A, [IY]
+    e.op({0x44, 0x10});             // LD A, [BR:ll]
+    e.op({0xCE, 0x40, 0x08});       // LD A, [IX+dd]
+    e.op({0xCE, 0x41, 0xF8});       // LD A, [IY+dd]
+    e.op({0xCE, 0x42});             // LD A, [IX+L]
+    e.op({0xCE, 0x43});             // LD A, [IY+L]
+    e.op({0xCE, 0xD0, 0x20, 0x1A}); // LD A, [hhll]
+    e.op({0xCF, 0x70, 0x02});       // LD BA, [SP+dd]
+    e.op({0x68});                   // LD [HL], A
+    e.op({0x78, 0x20});             // LD [BR:ll], A
+    e.op({0xCE, 0x44, 0x10});       // LD [IX+dd], A
+  });
+}
+
+static void setup_branch(Machine::State &cpu)
+{
+  prepare_cpu(cpu, [](Emitter &e) {
+    e.op({0xF1, e.rel(2, e.pc + 2)}); // JRS rr
+    e.op({0xE6, e.rel(2, e.pc + 2)}); // JRS Z, rr
+    e.op({0xE7, e.rel(2, e.pc + 2)}); // JRS NZ, rr
+    e.op({0xF5, e.rel(2, e.pc + 2)}); // DJR NZ, rr
+
+    int jrl = e.rel(3, e.pc + 3);
+    e.op({0xF3, jrl & 0xFF, (jrl >> 8) & 0xFF}); // JRL qqrr
+
+    int carl = e.rel(3, SUBROUTINE);
+    e.op({0xF2, carl & 0xFF, (carl >> 8) & 0xFF}); // CARL qqrr
+
+    e.op({0xFB, CALL_VECTOR & 0xFF, CALL_VECTOR >> 8}); // CALL [hhll]
+  });
+}
+
+static void setup_extended(Machine::State &cpu)
+{
+  prepare_cpu(cpu, [](Emitter &e) {
+    e.op({0xCF, 0x00});             // ADD BA, BA
+    e.op({0xCF, 0x05});             // ADC BA, HL
+    e.op({0xCF, 0x18});             // CP BA, BA
+    e.op({0xCF, 0x60, 0x34, 0x12}); // ADC BA, #mmnn
+    e.op({0xCE, 0x80});             // SLA A
+    e.op({0xCE, 0x90});             // RL A
+    e.op({0xCE, 0x94});             // RLC A
+    e.op({0xCE, 0xA0});             // CPL A
+    e.op({0xCE, 0xA4});             // NEG A
+    e.op({0xCE, 0xC0});             // LD A, BR
+    e.op({0xCF, 0xB0});             // PUSH A
+    e.op({0xCF, 0xB4});             // POP A
+  });
+}
+
+/**
+ * Whole machine, running the branch mix in a loop
+ **/
+
+static void setup_advance(Machine::State &cpu)
+{
+  setup_branch(cpu);
+
+  Emitter e(cpu, program_end);
+  int jrl = e.rel(3, PROGRAM_START);
+  e.op({0xF3, jrl & 0xFF, (jrl >> 8) & 0xFF}); // JRL qqrr
+
+  cpu.reg.pc = PROGRAM_START;
+}
+
+static void setup_advance_sampled(Machine::State &cpu)
+{
+  setup_advance(cpu);
+  set_sampling(cpu, 1000);
+}
+
+static void setup_advance_breakpoints(Machine::State &cpu)
+{
+  setup_advance(cpu);
+
+  // Armed, but never reached
+  for (uint32_t address = 0x100000; address < 0x100100; address += 4)
+  {
+    breakpoint_set(cpu, address);
+  }
+}
+
+static void setup_advance_watchpoints(Machine::State &cpu)
+{
+  setup_advance(cpu);
+
+  // Armed on a RAM page the loop never touches
+  watchpoint_set(cpu, 0x1800, 0x180F, Debugger::WATCH_READ | Debugger::WATCH_WRITE);
+}
+
+static void setup_advance_callgraph(Machine::State &cpu)
+{
+  setup_advance(cpu);
+  set_callgraph(cpu, true);
+}
+
+static void setup_advance_traced(Machine::State &cpu)
+{
+  setup_advance(cpu);
+  trace_enable(cpu, true);
+}
+
+static int run_advance(Machine::State &cpu)
+{
+  cpu_advance(cpu, OSC3_SPEED / 1000);
+
+  return 1;
+}
+
+/**
+ * LCD
+ **/
+
+static void setup_lcd(Machine::State &cpu)
+{
+  prepare(cpu);
+
+  LCD::write(cpu.lcd, 0b10101111, 0x20FE); // Display on
+
+  for (auto &page : cpu.lcd.gddram)
+    for (auto &byte : page)
+      byte = random8();
+
+  for (auto &row : cpu.buffers.lcd_history.planes)
+    for (auto &plane : row)
+      for (auto &byte : plane)
+        byte = random8();
+
+  cpu.lcd.volume = 0x20;
+
+  // Keep the blitter from running when the frame completes
+  cpu.blitter.frame_divider = 7;
+}
+
+static int run_lcd_scanline(Machine::State &cpu)
+{
+  cpu.lcd.scanline = (cpu.lcd.scanline + 1) % 0x3F;
+  cpu.lcd.overflow = OSC3_SPEED - LCD_SPEED;
+  LCD::clock(cpu, 1);
+
+  return 1;
+}
+
+// Flipping the start line changes every row source, so nothing converges
+static int run_lcd_scanline_dirty(Machine::State &cpu)
+{
+  LCD::write(cpu.lcd, 0b01000000 | (cpu.lcd.start_address ^ 1), 0x20FE);
+
+  return run_lcd_scanline(cpu);
+}
+
+static int run_lcd_frame_end(Machine::State &cpu)
+{
+  cpu.blitter.divider = 0;
+  cpu.lcd.scanline = 0x3F;
+  cpu.lcd.overflow = OSC3_SPEED - LCD_SPEED;
+  LCD::clock(cpu, 1);
+
+  return 1;
+}
+
+static int run_lcd_convert(Machine::State &cpu)
+{
+  run_lcd_frame_end(cpu);
+  get_frame(cpu, LCD::FRAME_RGBA32);
+
+  return 1;
+}
+
+static int run_lcd_read_1bpp(Machine::State &cpu)
+{
+  read_frame(cpu, LCD::FRAME_1BPP, cpu.buffers.transfer);
+
+  return 1;
+}
+
+static int run_lcd_read_intensity8(Machine::State &cpu)
+{
+  read_frame(cpu, LCD::FRAME_INTENSITY8, cpu.buffers.transfer);
+
+  return 1;
+}
+
+/**
+ * Blitter
+ **/
+
+static void setup_blitter(Machine::State &cpu)
+{
+  prepare(cpu);
+
+  cpu.blitter.enable_map = true;
+  cpu.blitter.enable_sprites = true;
+  cpu.blitter.map_size = 3;
+  cpu.blitter.frame_divider = 0;
+  cpu.blitter.map_base = MAP_BASE;
+  cpu.blitter.sprite_base = SPRITE_BASE;
+  cpu.blitter.scroll_x = 13;
+  cpu.blitter.scroll_y = 5;
+
+  for (auto &tile : cpu.overlay.map)
+    tile = random8();
+
+  for (int i = 0; i < 24; i++)
+  {
+    cpu.overlay.oam[i][0] = 16 + i * 4;
+    cpu.overlay.oam[i][1] = 8 + (i * 7) % 64;
+    cpu.overlay.oam[i][2] = i;
+    cpu.overlay.oam[i][3] = 0b1000 | (i & 0b111);
+  }
+}
+
+static void setup_blitter_copy(Machine::State &cpu)
+{
+  setup_blitter(cpu);
+  cpu.blitter.enable_copy = true;
+}
+
+static void setup_blitter_traced(Machine::State &cpu)
+{
+  setup_blitter(cpu);
+  trace_enable(cpu, true);
+}
+
+static void setup_blitter_copy_traced(Machine::State &cpu)
+{
+  setup_blitter_copy(cpu);
+  trace_enable(cpu, true);
+}
+
+// Scrolling, so that every frame is composited again
+static int run_blitter(Machine::State &cpu)
+{
+  cpu.blitter.divider = 2;
+  cpu.blitter.scroll_x ^= 1;
+  Blitter::clock(cpu);
+
+  return 1;
+}
+
+// A still screen, only the copy to the LCD is left
+static int run_blitter_still(Machine::State &cpu)
+{
+  cpu.blitter.divider = 2;
+  Blitter::clock(cpu);
+
+  return 1;
+}
+
+/**
+ * Timers
+ **/
+
+static void setup_timers(Machine::State &cpu, bool mode16)
+{
+  prepare(cpu);
+
+  cpu.timers.osc1_enable = true;
+  cpu.timers.osc3_enable = true;
+
+  for (auto &timer : cpu.timers.timer)
+  {
+    timer.mode16 = mode16;
+    timer.lo_running = timer.hi_running = true;
+    timer.lo_clock_ctrl = timer.hi_clock_ctrl = true;
+    timer.lo_clock_source = timer.hi_clock_source = false;
+    timer.lo_clock_ratio = timer.hi_clock_ratio = 0;
+    timer.preset = mode16 ? 0x1000 : 0x4080;
+    timer.compare = mode16 ? 0x0800 : 0x2040;
+  }
+}
+
+static int run_timers(Machine::State &cpu)
+{
+  Timers::clock(cpu, 0, OSC3_SPEED / CPU_SPEED);
+
+  return 1;
+}
+
+/**
+ * IRQ controller
+ **/
+
+static void setup_irq(Machine::State &cpu)
+{
+  prepare(cpu);
+
+  for (int i = 0x2020; i <= 0x2022; i++)
+    IRQ::write(cpu, 0b01010101, i);
+  for (int i = 0x2023; i <= 0x2026; i++)
+    IRQ::write(cpu, 0xFF, i);
+
+  // Keep the CPU from taking the interrupts
+  cpu.reg.flag.i = IRQ::HIGHEST_PRIO;
+}
+
+static int run_irq(Machine::State &cpu)
+{
+  IRQ::trigger(cpu, IRQ::IRQ_TIM0);
+  IRQ::write(cpu, 0b00000100, 0x2027);
+
+  return 1;
+}
+
+/**
+ * EEPROM, bit-banged over the GPIO port
+ **/
+
+static void pins(Machine::State &cpu, bool clock, bool data)
+{
+  GPIO::write(cpu.gpio, (clock ? GPIO_CLOCK : 0) | (data ? GPIO_DATA : 0), 0x2061);
+}
+
+static void i2c_start(Machine::State &cpu)
+{
+  GPIO::write(cpu.gpio, GPIO_CLOCK | GPIO_DATA, 0x2060);
+  pins(cpu, false, true);
+  pins(cpu, true, true);
+  pins(cpu, true, false);
+  pins(cpu, false, false);
+}
+
+static void i2c_stop(Machine::State &cpu)
+{
+  GPIO::write(cpu.gpio, GPIO_CLOCK | GPIO_DATA, 0x2060);
+  pins(cpu, false, false);
+  pins(cpu, true, false);
+  pins(cpu, true, true);
+}
+
+static void i2c_write(Machine::State &cpu, uint8_t data)
+{
+  GPIO::write(cpu.gpio, GPIO_CLOCK | GPIO_DATA, 0x2060);
+
+  for (int bit = 7; bit >= 0; bit--)
+  {
+    bool value = (data >> bit) & 1;
+    pins(cpu, false, value);
+    pins(cpu, true, value);
+  }
+
+  // Acknowledge
+  GPIO::write(cpu.gpio, GPIO_CLOCK, 0x2060);
+  pins(cpu, false, true);
+  pins(cpu, true, true);
+  pins(cpu, false, true);
+}
+
+static uint8_t i2c_read(Machine::State &cpu, bool ack)
+{
+  uint8_t data = 0;
+
+  GPIO::write(cpu.gpio, GPIO_CLOCK, 0x2060);
+
+  for (int bit = 7; bit >= 0; bit--)
+  {
+    pins(cpu, false, true);
+    pins(cpu, true, true);
+    data = (data << 1) | ((GPIO::read(cpu.gpio, 0x2061) & GPIO_DATA) ? 1 : 0);
+  }
+
+  GPIO::write(cpu.gpio, GPIO_CLOCK | GPIO_DATA, 0x2060);
+  pins(cpu, false, !ack);
+  pins(cpu, true, !ack);
+  pins(cpu, false, !ack);
+
+  return data;
+}
+
+static void setup_eeprom(Machine::State &cpu)
+{
+  prepare(cpu);
+}
+
+static int run_eeprom_write(Machine::State &cpu)
+{
+  static uint16_t address = 0;
+
+  i2c_start(cpu);
+  i2c_write(cpu, 0xA0);
+  i2c_write(cpu, address >> 8);
+  i2c_write(cpu, address & 0xFF);
+  i2c_write(cpu, random8());
+  i2c_stop(cpu);
+
+  address = (address + 1) & 0x1FFF;
+  return 1;
+}
+
+static int run_eeprom_read(Machine::State &cpu)
+{
+  static uint16_t address = 0;
+
+  i2c_start(cpu);
+  i2c_write(cpu, 0xA0);
+  i2c_write(cpu, address >> 8);
+  i2c_write(cpu, address & 0xFF);
+  i2c_start(cpu);
+  i2c_write(cpu, 0xA1);
+  i2c_read(cpu, false);
+  i2c_stop(cpu);
+
+  address = (address + 1) & 0x1FFF;
+  return 1;
+}
+
+/**
+ * Disassembly of a whole cartridge bank, the way the debugger pages through it
+ **/
+
+static void setup_disassemble(Machine::State &cpu)
+{
+  prepare(cpu);
+}
+
+static int run_disassemble_bank(Machine::State &cpu)
+{
+  const uint32_t end = 0x18000;
+  uint32_t address = 0x10000;
+
+  while (address < end)
+  {
+    uint32_t count = disassemble(cpu, address, Disassembler::BUFFER_RECORDS, cpu.buffers.disassembly);
+    const Disassembler::Record &last = cpu.buffers.disassembly[count - 1];
+
+    address = last.address + last.length;
+  }
+
+  return 1;
+}
+
+// Random bytes behind a valid header branch all over the cartridge, a worst case
+static void setup_analysis(Machine::State &cpu)
+{
+  prepare(cpu);
+
+  cpu.buffers.cartridge[0x2100] = 'M';
+  cpu.buffers.cartridge[0x2101] = 'N';
+}
+
+static int run_analysis(Machine::State &cpu)
+{
+  analyze_code(cpu);
+  return 1;
+}
+
+/**
+ * Host memory views, a memory panel refresh that spans RAM, registers and cartridge
+ **/
+
+static int run_peek_block(Machine::State &cpu)
+{
+  peek_block(cpu, 0x1000, Machine::TRANSFER_SIZE, cpu.buffers.transfer);
+  return 1;
+}
+
+static const Benchmark BENCHMARKS[] = {
+    {"cpu/alu", "instruction", setup_alu, run_cpu},
+    {"cpu/load_store", "instruction", setup_load, run_cpu},
+    {"cpu/branch", "instruction", setup_branch, run_cpu},
+    {"cpu/extended", "instruction", setup_extended, run_cpu},
+    {"machine/advance", "millisecond", setup_advance, run_advance},
+    {"machine/advance_sampled", "millisecond", setup_advance_sampled, run_advance},
+    {"machine/advance_breakpoints", "millisecond", setup_advance_breakpoints, run_advance},
+    {"machine/advance_watchpoints", "millisecond", setup_advance_watchpoints, run_advance},
+    {"machine/advance_callgraph", "millisecond", setup_advance_callgraph, run_advance},
+    {"machine/advance_traced", "millisecond", setup_advance_traced, run_advance},
+    {"lcd/scanline", "scanline", setup_lcd, run_lcd_scanline},
+    {"lcd/scanline_dirty", "scanline", setup_lcd, run_lcd_scanline_dirty},
+    {"lcd/frame_end", "frame", setup_lcd, run_lcd_frame_end},
+    {"lcd/convert", "frame", setup_lcd, run_lcd_convert},
+    {"lcd/read_1bpp", "frame", setup_lcd, run_lcd_read_1bpp},
+    {"lcd/read_intensity8", "frame", setup_lcd, run_lcd_read_intensity8},
+    {"blitter/map_sprites", "frame", setup_blitter, run_blitter},
+    {"blitter/map_sprites_copy", "frame", setup_blitter_copy, run_blitter},
+    {"blitter/map_sprites_traced", "frame", setup_blitter_traced, run_blitter},
+    {"blitter/still_copy", "frame", setup_blitter_copy, run_blitter_still},
+    {"blitter/still_copy_traced", "frame", setup_blitter_copy_traced, run_blitter_still},
+    {"timers/8bit", "cycle", [](Machine::State &cpu) { setup_timers(cpu, false); }, run_timers},
+    {"timers/16bit", "cycle", [](Machine::State &cpu) { setup_timers(cpu, true); }, run_timers},
+    {"irq/trigger_ack", "irq", setup_irq, run_irq},
+    {"eeprom/write_byte", "transaction", setup_eeprom, run_eeprom_write},
+    {"eeprom/read_byte", "transaction", setup_eeprom, run_eeprom_read},
+    {"memory/peek_block", "64KB", setup_disassemble, run_peek_block},
+    {"disassembler/bank", "bank", setup_disassemble, run_disassemble_bank},
+    {"disassembler/analyze_cartridge", "cartridge", setup_analysis, run_analysis},
+};
+
+static bool selected(const char *name, int argc, char **argv)
+{
+  if (argc <= 1)
+    return true;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strstr(name, argv[i]))
+      return true;
+  }
+
+  return false;
+}
+
+static void measure(const Benchmark &bench)
+{
+  using clock = std::chrono::steady_clock;
+
+  bench.setup(machine);
+
+  // Warm up caches and branch predictors
+  for (int i = 0; i < 16; i++)
+    bench.run(machine);
+
+  uint64_t calls = 0;
+  uint64_t operations = 0;
+  double seconds = 0;
+
+  for (uint64_t batch = 1;; batch *= 2)
+  {
+    auto start = clock::now();
+    for (uint64_t i = 0; i < batch; i++)
+      operations += bench.run(machine);
+    seconds += std::chrono::duration<double>(clock::now() - start).count();
+    calls += batch;
+
+    if (seconds >= MIN_SECONDS)
+      break;
+  }
+
+  printf("{\"name\":\"%s\",\"unit\":\"%s\",\"calls\":%llu,\"operations\":%llu,\"seconds\":%.6f,\"ns_per_op\":%.3f,\"ops_per_sec\":%.1f}\n",
+         bench.name, bench.unit,
+         (unsigned long long)calls, (unsigned long long)operations,
+         seconds, seconds * 1e9 / operations, operations / seconds);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+  for (const auto &bench : BENCHMARKS)
+  {
+    if (selected(bench.name, argc, argv))
+      measure(bench);
+  }
+
+  return 0;
+}
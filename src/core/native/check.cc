@@ -0,0 +1,410 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+ * Behaviour checks for the emulation core
+ *
+ * Usage: check [filter ...]
+ *
+ * Every check whose name contains one of the filters is run (all of them
+ * when no filter is given). Each prints one line, and the exit status is
+ * the number of checks that failed.
+ **/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <initializer_list>
+
+#include "machine.h"
+
+static const uint32_t PROGRAM_START = 0x1400;
+static const uint16_t STACK_TOP = 0x1E00;
+
+static Machine::State machine;
+static Machine::State reference;
+
+struct Check
+{
+  const char *name;
+  const char *(*run)(Machine::State &cpu);
+};
+
+/**
+ * Shared setup helpers
+ **/
+
+static void prepare(Machine::State &cpu)
+{
+  memset(&cpu, 0, sizeof(cpu));
+  cpu_initialize(cpu);
+
+  cpu.reg.pc = PROGRAM_START;
+  cpu.reg.sp = STACK_TOP;
+  cpu.reg.cb = cpu.reg.nb = 0;
+  cpu.reg.ep = cpu.reg.xp = cpu.reg.yp = 0;
+  cpu.reg.flag.i = 3; // Nothing interrupts the program
+}
+
+static void emit(Machine::State &cpu, uint32_t address, std::initializer_list<int> bytes)
+{
+  for (int byte : bytes)
+    cpu.ram[address++ & 0xFFF] = (uint8_t)byte;
+}
+
+/**
+ * Profiler
+ **/
+
+// A loop calling two three instruction subroutines back to back
+static void emit_call_loop(Machine::State &cpu)
+{
+  emit(cpu, PROGRAM_START + 0x00, {0xF2, 0x0E, 0x00}); // CARL $1410
+  emit(cpu, PROGRAM_START + 0x03, {0xF2, 0x13, 0x00}); // CARL $1418
+  emit(cpu, PROGRAM_START + 0x06, {0xF1, 0xF9});       // JRS $1400
+  emit(cpu, PROGRAM_START + 0x10, {0xFF, 0xFF, 0xF8}); // NOP, NOP, RET
+  emit(cpu, PROGRAM_START + 0x18, {0xFF, 0xFF, 0xF8}); // NOP, NOP, RET
+}
+
+// Stepping back inside the second call replays the first one's RET, at the
+// stack level of the frame that is still open
+static const char *check_step_back_over_ret(Machine::State &cpu)
+{
+  prepare(cpu);
+  emit_call_loop(cpu);
+
+  set_callgraph(cpu, true);
+  rewind_enable(cpu, 1000);
+
+  // CARL, NOP, NOP, RET, CARL, NOP
+  for (int i = 0; i < 6; i++)
+  {
+    cpu_step(cpu);
+  }
+
+  if (cpu.reg.pc != PROGRAM_START + 0x19)
+    return "program did not reach the second call";
+
+  static Profile::State before;
+  before = cpu.profile;
+
+  if (before.edge_count != 2 || before.depth != 1)
+    return "call graph missed the calls";
+
+  if (!cpu_step_back(cpu) || cpu.reg.pc != PROGRAM_START + 0x18)
+    return "did not step back";
+
+  if (cpu.profile.edge_count != before.edge_count ||
+      memcmp(cpu.profile.edges, before.edges, sizeof(before.edges)) ||
+      cpu.profile.cycles != before.cycles)
+    return "replay changed the call graph";
+
+  if (cpu.profile.depth != before.depth ||
+      memcmp(cpu.profile.stack, before.stack, sizeof(before.stack)))
+    return "replay changed the shadow stack";
+
+  return nullptr;
+}
+
+// Turning the call graph on and off leaves the sampler's open frames alone
+static const char *check_toggle_callgraph_while_sampling(Machine::State &cpu)
+{
+  prepare(cpu);
+  emit_call_loop(cpu);
+
+  set_sampling(cpu, 1000);
+
+  // CARL, NOP
+  cpu_step(cpu);
+  cpu_step(cpu);
+
+  if (cpu.profile.depth != 1)
+    return "sampler missed the call";
+
+  set_callgraph(cpu, true);
+  set_callgraph(cpu, false);
+  set_callgraph(cpu, true);
+
+  if (cpu.profile.depth != 1 || cpu.profile.stack[0].target != PROGRAM_START + 0x10)
+    return "call graph dropped the sampler's frame";
+
+  // NOP, RET closes a frame opened before the call graph, CARL opens one after
+  cpu_step(cpu);
+  cpu_step(cpu);
+
+  if (cpu.profile.depth != 0 || cpu.profile.edge_count != 0)
+    return "return was charged to an edge";
+
+  cpu_step(cpu);
+
+  if (cpu.profile.depth != 1 || cpu.profile.edge_count != 1 || cpu.profile.edges[0].calls != 1)
+    return "call graph missed the second call";
+
+  set_sampling(cpu, 0);
+
+  if (cpu.profile.depth != 1)
+    return "sampler dropped the call graph's frame";
+
+  return nullptr;
+}
+
+// Turning the call graph off keeps what it collected
+static const char *check_callgraph_kept_when_disabled(Machine::State &cpu)
+{
+  prepare(cpu);
+  emit_call_loop(cpu);
+
+  set_sampling(cpu, 1000);
+  set_callgraph(cpu, true);
+
+  // CARL, NOP, NOP, RET, CARL, NOP
+  for (int i = 0; i < 6; i++)
+  {
+    cpu_step(cpu);
+  }
+
+  set_callgraph(cpu, false);
+
+  static Profile::State before;
+  before = cpu.profile;
+
+  if (before.edge_count != 2 || before.edges[0].calls != 1 || !before.edges[0].inclusive)
+    return "call graph missed the calls";
+
+  // NOP, RET, JRS, CARL, NOP, NOP, RET
+  for (int i = 0; i < 7; i++)
+  {
+    cpu_step(cpu);
+  }
+
+  if (cpu.profile.edge_count != before.edge_count ||
+      memcmp(cpu.profile.edges, before.edges, sizeof(before.edges)))
+    return "table changed after the call graph was turned off";
+
+  return nullptr;
+}
+
+/**
+ * Debugger conditions
+ **/
+
+static void compile(Machine::State &cpu, std::initializer_list<int> program)
+{
+  uint8_t *target = cpu.debugger.program_buffer;
+
+  memset(target, Debugger::OP_END, sizeof(cpu.debugger.program_buffer));
+
+  for (int byte : program)
+    *target++ = (uint8_t)byte;
+}
+
+static const char *check_logpoint_at_breakpoint(Machine::State &cpu)
+{
+  prepare(cpu);
+  emit_call_loop(cpu);
+
+  compile(cpu, {Debugger::OP_PUSH, 42, 0, 0, 0, Debugger::OP_LOG});
+  condition_set(cpu, PROGRAM_START + 0x10, Debugger::CONDITION_LOG);
+  breakpoint_set(cpu, PROGRAM_START + 0x10);
+
+  if (cpu_advance(cpu, OSC3_SPEED / 1000) != Debugger::STOP_BREAKPOINT || cpu.reg.pc != PROGRAM_START + 0x10)
+    return "did not stop at the breakpoint";
+
+  if (cpu.debugger.log_index != 1 || cpu.debugger.log[0].value != 42)
+    return "logpoint did not log";
+
+  return nullptr;
+}
+
+// Overflowing operators wrap around instead of being undefined
+static const char *check_condition_wraps(Machine::State &cpu)
+{
+  prepare(cpu);
+  emit_call_loop(cpu);
+
+  compile(cpu, {
+                   Debugger::OP_PUSH, 0xFF, 0xFF, 0xFF, 0x7F, // 0x7FFFFFFF + 1
+                   Debugger::OP_PUSH, 0x01, 0x00, 0x00, 0x00,
+                   Debugger::OP_ADD,
+                   Debugger::OP_LOG,
+                   Debugger::OP_PUSH, 0x00, 0x00, 0x00, 0x00, // 0 - 0x80000000
+                   Debugger::OP_PUSH, 0x00, 0x00, 0x00, 0x80,
+                   Debugger::OP_SUB,
+                   Debugger::OP_LOG,
+                   Debugger::OP_PUSH, 0x00, 0x00, 0x00, 0x80, // -0x80000000
+                   Debugger::OP_NEG,
+                   Debugger::OP_LOG,
+               });
+  condition_set(cpu, PROGRAM_START, Debugger::CONDITION_LOG);
+  cpu_advance(cpu, 1);
+
+  if (cpu.debugger.log_index < 3 || cpu.debugger.condition_error)
+    return "logpoint did not run";
+
+  for (int i = 0; i < 3; i++)
+  {
+    if ((uint32_t)cpu.debugger.log[i].value != 0x80000000)
+      return "arithmetic did not wrap";
+  }
+
+  return nullptr;
+}
+
+/**
+ * Blitter
+ **/
+
+static const uint32_t SPRITE_BASE = 0x1800;
+static const uint32_t TILE_BASE = 0x1800;
+
+static void render_frame(Machine::State &cpu)
+{
+  cpu.blitter.frame_divider = 0;
+  cpu.blitter.divider = 2;
+  Blitter::clock(cpu);
+}
+
+// Sprites drawn from the cache leave the trace just as fetching them over
+// the bus does, clipped columns included
+static const char *check_traced_cached_sprites(Machine::State &cpu)
+{
+  prepare(cpu);
+
+  for (int i = 0; i < 0x200; i++)
+    cpu.ram[SPRITE_BASE - 0x1000 + i] = (uint8_t)(i * 37 + 11);
+
+  cpu.blitter.enable_sprites = true;
+  cpu.blitter.sprite_base = SPRITE_BASE;
+
+  // Clipped on the left, whole, clipped on the right, in every flip
+  for (int i = 0; i < 8; i++)
+  {
+    cpu.overlay.oam[i][0] = 4 + i * 14;
+    cpu.overlay.oam[i][1] = 16 + i * 4;
+    cpu.overlay.oam[i][2] = i;
+    cpu.overlay.oam[i][3] = 0b1000 | i;
+  }
+
+  trace_enable(cpu, true);
+  render_frame(cpu);
+
+  if (!cpu.sprite_cache.sprites[0][0].valid)
+    return "sprites were not cached";
+
+  trace_reset(cpu);
+  reference = cpu;
+  reference.debugger.watching = true;
+
+  render_frame(cpu);
+  render_frame(reference);
+
+  if (cpu.stats.trace_events != reference.stats.trace_events ||
+      memcmp(cpu.trace.attributes, reference.trace.attributes, sizeof(cpu.trace.attributes)))
+    return "trace differs from the bus";
+
+  if (memcmp(cpu.overlay.framebuffer, reference.overlay.framebuffer, sizeof(cpu.overlay.framebuffer)) ||
+      cpu.bus_cap != reference.bus_cap)
+    return "frame differs from the bus";
+
+  return nullptr;
+}
+
+// A still screen is not traced again until the trace forgets it
+static const char *check_traced_still_frame(Machine::State &cpu)
+{
+  prepare(cpu);
+
+  for (int i = 0; i < 0x800; i++)
+    cpu.ram[TILE_BASE - 0x1000 + i] = (uint8_t)(i * 37 + 11);
+
+  cpu.blitter.enable_map = true;
+  cpu.blitter.map_base = TILE_BASE;
+
+  trace_enable(cpu, true);
+  render_frame(cpu);
+
+  static uint8_t traced[0x800];
+  uint32_t events = cpu.stats.trace_events;
+  memcpy(traced, &cpu.trace.attributes[TILE_BASE], sizeof(traced));
+
+  render_frame(cpu);
+
+  if (cpu.stats.trace_events != events)
+    return "still frame was composited again";
+
+  trace_reset(cpu);
+  render_frame(cpu);
+
+  if (cpu.stats.trace_events == events || memcmp(traced, &cpu.trace.attributes[TILE_BASE], sizeof(traced)))
+    return "frame was not traced again after a reset";
+
+  return nullptr;
+}
+
+/**
+ * Runner
+ **/
+
+static const Check CHECKS[] = {
+    {"profile/step_back_over_ret", check_step_back_over_ret},
+    {"profile/toggle_callgraph_while_sampling", check_toggle_callgraph_while_sampling},
+    {"profile/callgraph_kept_when_disabled", check_callgraph_kept_when_disabled},
+    {"debugger/logpoint_at_breakpoint", check_logpoint_at_breakpoint},
+    {"debugger/condition_wraps", check_condition_wraps},
+    {"blitter/traced_cached_sprites", check_traced_cached_sprites},
+    {"blitter/traced_still_frame", check_traced_still_frame},
+};
+
+static bool selected(const char *name, int argc, char **argv)
+{
+  if (argc <= 1)
+    return true;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strstr(name, argv[i]))
+      return true;
+  }
+
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  int failed = 0;
+
+  for (const Check &check : CHECKS)
+  {
+    if (!selected(check.name, argc, argv))
+      continue;
+
+    const char *error = check.run(machine);
+
+    if (error)
+    {
+      printf("FAIL %s: %s\n", check.name, error);
+      failed++;
+    }
+    else
+    {
+      printf("ok   %s\n", check.name);
+    }
+  }
+
+  return failed;
+}
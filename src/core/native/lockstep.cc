@@ -0,0 +1,659 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+ * Finds the first instruction where two runs of a ROM disagree
+ *
+ * Usage: lockstep <rom> [-a config] [-b config] [-m movie] [-n instructions] [-i ms] [-s]
+ *        lockstep -t <trace a> <trace b>
+ *
+ * Two machines run the same ROM and input movie side by side, each with one
+ * of the configurations below. Every -i milliseconds of emulated time a hash
+ * of each subsystem is compared. After a mismatch, both machines are rebooted
+ * and run to the last matching point. They are then stepped one instruction
+ * at a time until the states part. With -s, the instruction recorder compares
+ * the registers before every instruction instead.
+ *
+ * Different core builds cannot share a process. Record the same ROM with
+ * each build, then compare the trace files with -t.
+ *
+ * A movie is a text file of "<millisecond> <input bits in hex>" lines. Bits
+ * are active low, as update_inputs takes them.
+ *
+ * Runs end at the instruction limit, or after IDLE_MS of emulated time with
+ * no instructions executed once the movie is over.
+ **/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "machine.h"
+#include "tracefile.h"
+
+static const uint64_t DEFAULT_INSTRUCTIONS = 100000000;
+static const int IDLE_MS = 10000;
+static const int DEFAULT_INTERVAL_MS = 10;
+static const int TICKS_PER_MS = OSC3_SPEED / 1000;
+static const uint16_t INPUTS_RELEASED = 0b1111111111;
+static const uint16_t INPUT_CART_N = 0b1000000000;
+static const int RAM_REPORT_LIMIT = 16;
+
+static const uint8_t BIOS[] = {
+#include "bios.h"
+};
+
+static Machine::State machines[2];
+
+/**
+ * Configurations, each only switches paths that must not change emulation
+ **/
+
+struct Config
+{
+  const char *name;
+  void (*setup)(Machine::State &cpu);
+};
+
+static void setup_plain(Machine::State &cpu)
+{
+}
+
+static void setup_traced(Machine::State &cpu)
+{
+  trace_enable(cpu, true);
+}
+
+static void setup_debugger(Machine::State &cpu)
+{
+  // Armed, but on addresses nothing executes or touches
+  breakpoint_set(cpu, 0x1FFFFF);
+  watchpoint_set(cpu, 0x1FFFF0, 0x1FFFFE, Debugger::WATCH_READ | Debugger::WATCH_WRITE);
+}
+
+static void setup_rewind(Machine::State &cpu)
+{
+  rewind_enable(cpu, 10000);
+}
+
+static void setup_profiled(Machine::State &cpu)
+{
+  set_sampling(cpu, 1000);
+  set_callgraph(cpu, true);
+}
+
+static const Config CONFIGS[] = {
+    {"plain", setup_plain},
+    {"traced", setup_traced},
+    {"debugger", setup_debugger},
+    {"rewind", setup_rewind},
+    {"profiled", setup_profiled},
+};
+
+static const Config *find_config(const char *name)
+{
+  for (const Config &config : CONFIGS)
+  {
+    if (!strcmp(config.name, name))
+      return &config;
+  }
+
+  return nullptr;
+}
+
+/**
+ * State hashing, over what Rewind snapshots as the machine's execution state
+ **/
+
+struct Region
+{
+  const char *name;
+  size_t offset;
+  size_t size;
+};
+
+#define REGION(name, field) {name, offsetof(Machine::State, field), sizeof(Machine::State::field)}
+
+static const Region REGIONS[] = {
+    REGION("cpu", reg),
+    REGION("irq", irq),
+    REGION("lcd", lcd),
+    REGION("rtc", rtc),
+    REGION("control", ctrl),
+    REGION("tim256", tim256),
+    REGION("blitter", blitter),
+    REGION("timers", timers),
+    REGION("input", input),
+    REGION("gpio", gpio),
+    REGION("audio", audio),
+    REGION("bus_cap", bus_cap),
+    REGION("osc1", osc1_overflow),
+    REGION("status", status),
+    REGION("ram", ram),
+    REGION("lcd_history", buffers.lcd_history),
+};
+
+static const int REGION_COUNT = sizeof(REGIONS) / sizeof(REGIONS[0]);
+
+static uint64_t hash(const uint8_t *data, size_t size)
+{
+  uint64_t h = size * 0x9E3779B97F4A7C15ull;
+  size_t i = 0;
+
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    h = (h ^ word) * 0xFF51AFD7ED558CCDull;
+    h ^= h >> 32;
+  }
+
+  for (; i < size; i++)
+  {
+    h = (h ^ data[i]) * 0xC4CEB9FE1A85EC53ull;
+  }
+
+  return h ^ (h >> 29);
+}
+
+static void hash_regions(const Machine::State &cpu, uint64_t *out)
+{
+  const uint8_t *base = (const uint8_t *)&cpu;
+
+  for (int i = 0; i < REGION_COUNT; i++)
+  {
+    out[i] = hash(base + REGIONS[i].offset, REGIONS[i].size);
+  }
+}
+
+/**
+ * Reporting
+ **/
+
+// The same fields the recorder keeps, so both modes print alike
+static Recorder::Entry registers(Machine::State &cpu)
+{
+  Recorder::Entry entry = {};
+  uint32_t address = calc_pc(cpu);
+
+  entry.cycle = cpu.stats.cycles;
+  entry.address = address;
+
+  for (int i = 0; i < 4; i++)
+    entry.bytes[i] = Debugger::peek8(cpu, address + i);
+
+  entry.pc = cpu.reg.pc;
+  entry.ba = cpu.reg.ba;
+  entry.hl = cpu.reg.hl;
+  entry.ix = cpu.reg.ix;
+  entry.iy = cpu.reg.iy;
+  entry.sp = cpu.reg.sp;
+  entry.br = cpu.reg.br;
+  entry.ep = cpu.reg.ep;
+  entry.xp = cpu.reg.xp;
+  entry.yp = cpu.reg.yp;
+  entry.nb = cpu.reg.nb;
+  entry.cb = cpu.reg.cb;
+  entry.sc = cpu_readSC(cpu);
+
+  return entry;
+}
+
+static void print_row(const char *name, uint64_t a, uint64_t b, int digits)
+{
+  printf("  %-10s %0*llX%*s %0*llX%s\n", name,
+         digits, (unsigned long long)a, 18 - digits, "",
+         digits, (unsigned long long)b, a != b ? "   <<" : "");
+}
+
+static void print_entries(const char *title, const Recorder::Entry &a, const Recorder::Entry &b)
+{
+  printf("%s\n", title);
+  print_row("cycle", a.cycle, b.cycle, 12);
+  print_row("address", a.address, b.address, 6);
+  print_row("bytes",
+            ((uint32_t)a.bytes[0] << 24) | (a.bytes[1] << 16) | (a.bytes[2] << 8) | a.bytes[3],
+            ((uint32_t)b.bytes[0] << 24) | (b.bytes[1] << 16) | (b.bytes[2] << 8) | b.bytes[3], 8);
+  print_row("pc", a.pc, b.pc, 4);
+  print_row("ba", a.ba, b.ba, 4);
+  print_row("hl", a.hl, b.hl, 4);
+  print_row("ix", a.ix, b.ix, 4);
+  print_row("iy", a.iy, b.iy, 4);
+  print_row("sp", a.sp, b.sp, 4);
+  print_row("br", a.br, b.br, 2);
+  print_row("ep", a.ep, b.ep, 2);
+  print_row("xp", a.xp, b.xp, 2);
+  print_row("yp", a.yp, b.yp, 2);
+  print_row("nb", a.nb, b.nb, 2);
+  print_row("cb", a.cb, b.cb, 2);
+  print_row("sc", a.sc, b.sc, 2);
+}
+
+static void print_divergence(Machine::State &a, Machine::State &b)
+{
+  uint64_t hashes[2][REGION_COUNT];
+
+  hash_regions(a, hashes[0]);
+  hash_regions(b, hashes[1]);
+
+  print_entries("State after it", registers(a), registers(b));
+
+  printf("Subsystem hashes\n");
+  for (int i = 0; i < REGION_COUNT; i++)
+  {
+    print_row(REGIONS[i].name, hashes[0][i], hashes[1][i], 16);
+  }
+
+  int shown = 0;
+  for (int i = 0; i < (int)sizeof(a.ram) && shown < RAM_REPORT_LIMIT; i++)
+  {
+    if (a.ram[i] != b.ram[i])
+    {
+      if (!shown++)
+        printf("RAM differences\n");
+
+      printf("  %04X       %02X                 %02X\n", 0x1000 + i, a.ram[i], b.ram[i]);
+    }
+  }
+}
+
+/**
+ * Running
+ **/
+
+struct MovieInput
+{
+  uint64_t ms;
+  uint16_t value;
+};
+
+struct Run
+{
+  const Config *configs[2];
+  std::vector<uint8_t> rom;
+  uint32_t rom_offset;
+  std::vector<MovieInput> movie;
+  uint64_t limit;
+  int interval;
+  bool per_instruction;
+  size_t next_input;
+};
+
+static bool read_file(const char *path, std::vector<uint8_t> &out)
+{
+  FILE *file = fopen(path, "rb");
+
+  if (!file)
+    return false;
+
+  uint8_t chunk[0x10000];
+  size_t read;
+
+  while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    out.insert(out.end(), chunk, chunk + read);
+
+  fclose(file);
+  return !out.empty();
+}
+
+static bool read_movie(const char *path, std::vector<MovieInput> &out)
+{
+  FILE *file = fopen(path, "r");
+
+  if (!file)
+    return false;
+
+  unsigned long long ms;
+  unsigned value;
+
+  while (fscanf(file, "%llu %x", &ms, &value) == 2)
+    out.push_back({ms, (uint16_t)value});
+
+  fclose(file);
+  return true;
+}
+
+static void boot(Run &run)
+{
+  for (int side = 0; side < 2; side++)
+  {
+    Machine::State &cpu = machines[side];
+    size_t size = run.rom.size();
+
+    memset(&cpu, 0, sizeof(cpu));
+    memcpy(cpu.buffers.bios, BIOS, sizeof(BIOS));
+
+    if (size > sizeof(cpu.buffers.cartridge) - run.rom_offset)
+      size = sizeof(cpu.buffers.cartridge) - run.rom_offset;
+    memcpy(cpu.buffers.cartridge + run.rom_offset, run.rom.data(), size);
+
+    update_inputs(cpu, INPUTS_RELEASED & ~INPUT_CART_N);
+    cpu_initialize(cpu);
+    run.configs[side]->setup(cpu);
+    recorder_enable(cpu, run.per_instruction);
+  }
+
+  run.next_input = 0;
+}
+
+static void apply_inputs(Run &run, uint64_t ms)
+{
+  for (; run.next_input < run.movie.size() && run.movie[run.next_input].ms <= ms; run.next_input++)
+  {
+    for (Machine::State &cpu : machines)
+      update_inputs(cpu, run.movie[run.next_input].value);
+  }
+}
+
+static bool advance(Machine::State &cpu, int ticks)
+{
+  Debugger::StopReason reason = cpu_advance(cpu, ticks);
+
+  while (reason != Debugger::STOP_NONE)
+  {
+    // A millisecond never comes near filling the ring, so it means nobody drained it
+    if (reason == Debugger::STOP_RECORDER_FULL)
+      return false;
+
+    Debugger::resume_at(cpu, calc_pc(cpu));
+    reason = cpu_advance(cpu, 0);
+  }
+
+  return true;
+}
+
+// Pairs up recorded instructions, returns false at the first that differs
+static bool compare_recorded(uint64_t &compared)
+{
+  Recorder::State &a = machines[0].recorder;
+  Recorder::State &b = machines[1].recorder;
+  static Recorder::Entry previous[2];
+
+  while (a.tail != a.head && b.tail != b.head)
+  {
+    const Recorder::Entry &ea = a.ring[a.tail & (Recorder::RING_SIZE - 1)];
+    const Recorder::Entry &eb = b.ring[b.tail & (Recorder::RING_SIZE - 1)];
+
+    if (memcmp(&ea, &eb, sizeof(ea)))
+    {
+      printf("Registers differ before instruction %llu\n", (unsigned long long)compared);
+      if (compared)
+        print_entries("Previous instruction (the one that diverged)", previous[0], previous[1]);
+      print_entries("Next instruction", ea, eb);
+      return false;
+    }
+
+    previous[0] = ea;
+    previous[1] = eb;
+    a.tail++;
+    b.tail++;
+    compared++;
+  }
+
+  return true;
+}
+
+static bool states_match(const Machine::State &a, const Machine::State &b)
+{
+  uint64_t hashes[2][REGION_COUNT];
+
+  hash_regions(a, hashes[0]);
+  hash_regions(b, hashes[1]);
+
+  return !memcmp(hashes[0], hashes[1], sizeof(hashes[0]));
+}
+
+// Replays to the last matching millisecond, then steps a tick at a time.
+// cpu_advance only starts an instruction while it is owed ticks, and every
+// instruction costs more than one, so each call runs at most one of them
+static void narrow(Run &run, uint64_t good_ms)
+{
+  Machine::State &a = machines[0];
+  Machine::State &b = machines[1];
+
+  boot(run);
+
+  for (uint64_t ms = 0; ms < good_ms; ms++)
+  {
+    apply_inputs(run, ms);
+    advance(a, TICKS_PER_MS);
+    advance(b, TICKS_PER_MS);
+  }
+
+  // Both runs are deterministic, so the mismatch shows up within the interval again
+  for (uint64_t ms = good_ms; ms <= good_ms + run.interval; ms++)
+  {
+    apply_inputs(run, ms);
+
+    for (int tick = 0; tick < TICKS_PER_MS; tick++)
+    {
+      Recorder::Entry before[2] = {registers(a), registers(b)};
+      uint64_t executed = a.stats.instructions;
+
+      advance(a, 1);
+      advance(b, 1);
+
+      if (a.stats.cycles == before[0].cycle && b.stats.cycles == before[1].cycle)
+        continue;
+
+      if (!states_match(a, b) || a.stats.instructions != b.stats.instructions)
+      {
+        printf("First divergence at instruction %llu, %.3f ms emulated\n",
+               (unsigned long long)executed, ms + tick / (double)TICKS_PER_MS);
+        print_entries("Instruction", before[0], before[1]);
+        print_divergence(a, b);
+        return;
+      }
+    }
+  }
+
+  printf("The replay did not diverge, one of the configurations is not deterministic\n");
+}
+
+static int run_lockstep(Run &run)
+{
+  Machine::State &a = machines[0];
+  Machine::State &b = machines[1];
+  uint64_t good_ms = 0;
+  uint64_t compared = 0;
+  uint64_t last_instructions = 0;
+  int idle = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  boot(run);
+
+  for (uint64_t ms = 0; a.stats.instructions < run.limit; ms++)
+  {
+    apply_inputs(run, ms);
+
+    if (!advance(a, TICKS_PER_MS) || !advance(b, TICKS_PER_MS))
+    {
+      fprintf(stderr, "Instruction recorder overflowed\n");
+      return 2;
+    }
+
+    if (run.per_instruction)
+    {
+      if (!compare_recorded(compared))
+        return 1;
+    }
+    else if ((ms + 1) % run.interval == 0)
+    {
+      if (!states_match(a, b))
+      {
+        printf("Subsystem hashes differ between %llu and %llu ms, narrowing\n",
+               (unsigned long long)good_ms, (unsigned long long)ms + 1);
+        narrow(run, good_ms);
+        return 1;
+      }
+
+      good_ms = ms + 1;
+    }
+
+    if (a.status == Machine::STATUS_CRASHED && b.status == Machine::STATUS_CRASHED)
+      break;
+
+    // A sleeping CPU with no input left to wake it will not reach the limit
+    idle = (a.stats.instructions == last_instructions) ? idle + 1 : 0;
+    last_instructions = a.stats.instructions;
+
+    if (idle >= IDLE_MS && run.next_input >= run.movie.size())
+      break;
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("No divergence between %s and %s in %llu instructions (%.1fM instructions/s in lockstep)\n",
+         run.configs[0]->name, run.configs[1]->name, (unsigned long long)a.stats.instructions,
+         a.stats.instructions / seconds / 1e6);
+
+  return 0;
+}
+
+static int compare_traces(const char *path_a, const char *path_b)
+{
+  TraceFile::Reader a, b;
+  Recorder::Entry ea, eb, previous[2] = {};
+
+  if (!a.open(path_a) || !b.open(path_b))
+  {
+    fprintf(stderr, "Cannot read trace files\n");
+    return 2;
+  }
+
+  for (;;)
+  {
+    bool more_a = a.next(ea);
+    bool more_b = b.next(eb);
+
+    if (a.error() || b.error())
+    {
+      fprintf(stderr, "Corrupt trace file\n");
+      return 2;
+    }
+
+    if (!more_a || !more_b)
+    {
+      if (more_a != more_b)
+      {
+        printf("Traces match for %llu instructions, then %s ends\n",
+               (unsigned long long)(more_a ? b.position() : a.position()), more_a ? path_b : path_a);
+        return 1;
+      }
+
+      printf("Traces match, %llu instructions\n", (unsigned long long)a.position());
+      return 0;
+    }
+
+    if (memcmp(&ea, &eb, sizeof(ea)))
+    {
+      uint64_t index = a.position() - 1;
+
+      printf("Registers differ before instruction %llu\n", (unsigned long long)index);
+      if (index)
+        print_entries("Previous instruction (the one that diverged)", previous[0], previous[1]);
+      print_entries("Next instruction", ea, eb);
+      return 1;
+    }
+
+    previous[0] = ea;
+    previous[1] = eb;
+  }
+}
+
+static int usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s <rom> [-a config] [-b config] [-m movie] [-n instructions] [-i ms] [-s]\n", name);
+  fprintf(stderr, "       %s -t <trace a> <trace b>\n", name);
+  fprintf(stderr, "Configurations:");
+  for (const Config &config : CONFIGS)
+    fprintf(stderr, " %s", config.name);
+  fprintf(stderr, "\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc == 4 && !strcmp(argv[1], "-t"))
+  {
+    return compare_traces(argv[2], argv[3]);
+  }
+
+  if (argc < 2)
+  {
+    return usage(argv[0]);
+  }
+
+  static Run run;
+  run.configs[0] = run.configs[1] = &CONFIGS[0];
+  run.limit = DEFAULT_INSTRUCTIONS;
+  run.interval = DEFAULT_INTERVAL_MS;
+
+  for (int i = 2; i < argc; i++)
+  {
+    const char *option = argv[i];
+    const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+    if (!strcmp(option, "-s"))
+    {
+      run.per_instruction = true;
+      continue;
+    }
+
+    if (!value)
+      return usage(argv[0]);
+    i++;
+
+    if (!strcmp(option, "-a") || !strcmp(option, "-b"))
+    {
+      const Config *config = find_config(value);
+      if (!config)
+        return usage(argv[0]);
+      run.configs[option[1] == 'b'] = config;
+    }
+    else if (!strcmp(option, "-m"))
+    {
+      if (!read_movie(value, run.movie))
+      {
+        fprintf(stderr, "Cannot read %s\n", value);
+        return 2;
+      }
+    }
+    else if (!strcmp(option, "-n"))
+      run.limit = strtoull(value, nullptr, 0);
+    else if (!strcmp(option, "-i"))
+      run.interval = atoi(value) > 0 ? atoi(value) : 1;
+    else
+      return usage(argv[0]);
+  }
+
+  if (!read_file(argv[1], run.rom))
+  {
+    fprintf(stderr, "Cannot read %s\n", argv[1]);
+    return 2;
+  }
+
+  // Images starting with the "PM" header are dumps of the mapped cartridge area
+  run.rom_offset = (run.rom.size() >= 2 && run.rom[0] == 'P' && run.rom[1] == 'M') ? 0x2100 : 0;
+
+  return run_lockstep(run);
+}
@@ -0,0 +1,163 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+ * Records every instruction a ROM executes to a trace file
+ *
+ * Usage: record <rom> <trace> [instructions]
+ *
+ * The core runs on the main thread and fills the recorder ring, a second
+ * thread drains it into the encoder, so recording runs at interpreter speed
+ * whenever the encoder keeps up. Without a count, recording stops once
+ * 10 million instructions have been written. It also stops when the CPU
+ * crashes or executes nothing for IDLE_MS of emulated time.
+ **/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "machine.h"
+#include "tracefile.h"
+
+static const uint64_t DEFAULT_INSTRUCTIONS = 10000000;
+static const int IDLE_MS = 10000;
+static const uint32_t DRAIN_BATCH = Recorder::RING_SIZE / 4;
+static const int DRAIN_SLEEP_US = 100;
+static const uint16_t INPUTS_RELEASED = 0b1111111111;
+static const uint16_t INPUT_CART_N = 0b1000000000;
+
+static const uint8_t BIOS[] = {
+#include "bios.h"
+};
+
+static Machine::State machine;
+
+static bool load(Machine::State &cpu, const char *path)
+{
+  FILE *file = fopen(path, "rb");
+
+  if (!file)
+  {
+    return false;
+  }
+
+  // Images starting with the "PM" header are dumps of the mapped cartridge area
+  uint8_t header[2] = {0, 0};
+  size_t read = fread(header, 1, sizeof(header), file);
+  uint32_t offset = (read == 2 && header[0] == 'P' && header[1] == 'M') ? 0x2100 : 0;
+
+  fseek(file, 0, SEEK_SET);
+  read = fread(cpu.buffers.cartridge + offset, 1, sizeof(cpu.buffers.cartridge) - offset, file);
+  fclose(file);
+
+  return read > 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    fprintf(stderr, "Usage: %s <rom> <trace> [instructions]\n", argv[0]);
+    return 1;
+  }
+
+  uint64_t limit = (argc > 3) ? strtoull(argv[3], nullptr, 0) : DEFAULT_INSTRUCTIONS;
+
+  memcpy(machine.buffers.bios, BIOS, sizeof(BIOS));
+
+  if (!load(machine, argv[1]))
+  {
+    fprintf(stderr, "Cannot read %s\n", argv[1]);
+    return 1;
+  }
+
+  TraceFile::Writer writer;
+
+  if (!writer.open(argv[2]))
+  {
+    fprintf(stderr, "Cannot create %s\n", argv[2]);
+    return 1;
+  }
+
+  update_inputs(machine, INPUTS_RELEASED & ~INPUT_CART_N);
+  cpu_initialize(machine);
+  recorder_enable(machine, true);
+
+  Recorder::State &recorder = machine.recorder;
+  std::atomic<bool> finished(false);
+
+  // Draining in batches keeps the consumer off the cache line the core writes
+  std::thread drain([&]() {
+    for (;;)
+    {
+      bool done = finished.load(std::memory_order_acquire);
+      uint32_t head = __atomic_load_n(&recorder.head, __ATOMIC_ACQUIRE);
+      uint32_t tail = recorder.tail;
+
+      if (head - tail < DRAIN_BATCH && !done)
+      {
+        std::this_thread::sleep_for(std::chrono::microseconds(DRAIN_SLEEP_US));
+        continue;
+      }
+
+      for (; tail != head && writer.entries() < limit; tail++)
+      {
+        writer.append(recorder.ring[tail & (Recorder::RING_SIZE - 1)]);
+      }
+
+      __atomic_store_n(&recorder.tail, head, __ATOMIC_RELEASE);
+
+      if (done)
+        break;
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t last_instructions = 0;
+  int idle = 0;
+
+  while (machine.stats.instructions < limit && machine.status != Machine::STATUS_CRASHED && idle < IDLE_MS)
+  {
+    if (cpu_advance(machine, OSC3_SPEED / 1000) == Debugger::STOP_RECORDER_FULL)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    idle = (machine.stats.instructions == last_instructions) ? idle + 1 : 0;
+    last_instructions = machine.stats.instructions;
+  }
+
+  finished.store(true, std::memory_order_release);
+  drain.join();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  bool ok = writer.close();
+
+  fprintf(stderr, "%llu instructions, %llu bytes (%.2f per instruction), %u dropped, %.2fs (%.1fM instructions/s)\n",
+          (unsigned long long)writer.entries(), (unsigned long long)writer.bytes(),
+          writer.entries() ? (double)writer.bytes() / writer.entries() : 0.0,
+          recorder.dropped, seconds, writer.entries() / seconds / 1e6);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,634 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracefile.h"
+
+using namespace TraceFile;
+
+/**
+ * Entry encoding
+ *
+ * varint field mask, varint cycle delta, zigzag varint PC delta, then the
+ * fields named by the mask. Opcode bytes are only stored when they differ
+ * from the last ones seen at the same PC in this block.
+ **/
+
+enum Field : uint32_t
+{
+  FIELD_BYTES = 1 << 0,
+  FIELD_BA = 1 << 1,
+  FIELD_HL = 1 << 2,
+  FIELD_IX = 1 << 3,
+  FIELD_IY = 1 << 4,
+  FIELD_SP = 1 << 5,
+  FIELD_BR = 1 << 6,
+  FIELD_EP = 1 << 7,
+  FIELD_XP = 1 << 8,
+  FIELD_YP = 1 << 9,
+  FIELD_NB = 1 << 10,
+  FIELD_CB = 1 << 11,
+  FIELD_SC = 1 << 12
+};
+
+static const uint32_t MAX_ENCODED_ENTRY = 40;
+static const uint32_t BLOCK_CAPACITY = BLOCK_ENTRIES * MAX_ENCODED_ENTRY;
+static const int CODE_BITS = 16;
+
+static inline uint32_t code_slot(uint32_t address)
+{
+  return (address ^ (address >> CODE_BITS)) & ((1 << CODE_BITS) - 1);
+}
+
+static inline uint32_t code_word(const uint8_t *bytes)
+{
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static inline uint32_t physical(uint16_t pc, uint8_t cb)
+{
+  return (pc & 0x8000) ? ((cb << 15) | (pc & 0x7FFF)) : pc;
+}
+
+static inline uint8_t *put_varint(uint8_t *out, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    *out++ = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+
+  *out++ = value;
+  return out;
+}
+
+static inline uint8_t *put16(uint8_t *out, uint16_t value)
+{
+  *out++ = value;
+  *out++ = value >> 8;
+  return out;
+}
+
+// Bounds checked reads of one block's encoded bytes
+struct Cursor
+{
+  const uint8_t *data;
+  uint32_t position;
+  uint32_t size;
+  bool failed;
+
+  uint8_t u8()
+  {
+    if (position >= size)
+    {
+      failed = true;
+      return 0;
+    }
+    return data[position++];
+  }
+
+  uint16_t u16()
+  {
+    uint16_t lo = u8();
+    return lo | (u8() << 8);
+  }
+
+  uint64_t varint()
+  {
+    uint64_t value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+      uint8_t byte = u8();
+      value |= (uint64_t)(byte & 0x7F) << shift;
+
+      if (~byte & 0x80)
+      {
+        return value;
+      }
+    }
+
+    failed = true;
+    return 0;
+  }
+};
+
+static uint8_t *encode(uint8_t *out, const Recorder::Entry &entry, const Recorder::Entry &previous, uint32_t *code)
+{
+  uint32_t mask = 0;
+  uint32_t &cached = code[code_slot(entry.address)];
+  uint32_t bytes = code_word(entry.bytes);
+
+  if (cached != bytes)
+  {
+    cached = bytes;
+    mask |= FIELD_BYTES;
+  }
+
+  if (entry.ba != previous.ba) mask |= FIELD_BA;
+  if (entry.hl != previous.hl) mask |= FIELD_HL;
+  if (entry.ix != previous.ix) mask |= FIELD_IX;
+  if (entry.iy != previous.iy) mask |= FIELD_IY;
+  if (entry.sp != previous.sp) mask |= FIELD_SP;
+  if (entry.br != previous.br) mask |= FIELD_BR;
+  if (entry.ep != previous.ep) mask |= FIELD_EP;
+  if (entry.xp != previous.xp) mask |= FIELD_XP;
+  if (entry.yp != previous.yp) mask |= FIELD_YP;
+  if (entry.nb != previous.nb) mask |= FIELD_NB;
+  if (entry.cb != previous.cb) mask |= FIELD_CB;
+  if (entry.sc != previous.sc) mask |= FIELD_SC;
+
+  int16_t pc = entry.pc - previous.pc;
+
+  out = put_varint(out, mask);
+  out = put_varint(out, entry.cycle - previous.cycle);
+  out = put_varint(out, (uint16_t)((pc << 1) ^ (pc >> 15)));
+
+  if (mask & FIELD_BYTES)
+  {
+    memcpy(out, entry.bytes, sizeof(entry.bytes));
+    out += sizeof(entry.bytes);
+  }
+
+  if (mask & FIELD_BA) out = put16(out, entry.ba);
+  if (mask & FIELD_HL) out = put16(out, entry.hl);
+  if (mask & FIELD_IX) out = put16(out, entry.ix);
+  if (mask & FIELD_IY) out = put16(out, entry.iy);
+  if (mask & FIELD_SP) out = put16(out, entry.sp);
+  if (mask & FIELD_BR) *out++ = entry.br;
+  if (mask & FIELD_EP) *out++ = entry.ep;
+  if (mask & FIELD_XP) *out++ = entry.xp;
+  if (mask & FIELD_YP) *out++ = entry.yp;
+  if (mask & FIELD_NB) *out++ = entry.nb;
+  if (mask & FIELD_CB) *out++ = entry.cb;
+  if (mask & FIELD_SC) *out++ = entry.sc;
+
+  return out;
+}
+
+static bool decode(Cursor &in, Recorder::Entry &entry, const Recorder::Entry &previous, uint32_t *code)
+{
+  uint32_t mask = in.varint();
+
+  entry = previous;
+  entry.cycle = previous.cycle + in.varint();
+
+  uint16_t pc = in.varint();
+  entry.pc = previous.pc + (int16_t)((pc >> 1) ^ -(pc & 1));
+
+  if (mask & FIELD_BYTES)
+  {
+    for (auto &byte : entry.bytes)
+      byte = in.u8();
+  }
+
+  if (mask & FIELD_BA) entry.ba = in.u16();
+  if (mask & FIELD_HL) entry.hl = in.u16();
+  if (mask & FIELD_IX) entry.ix = in.u16();
+  if (mask & FIELD_IY) entry.iy = in.u16();
+  if (mask & FIELD_SP) entry.sp = in.u16();
+  if (mask & FIELD_BR) entry.br = in.u8();
+  if (mask & FIELD_EP) entry.ep = in.u8();
+  if (mask & FIELD_XP) entry.xp = in.u8();
+  if (mask & FIELD_YP) entry.yp = in.u8();
+  if (mask & FIELD_NB) entry.nb = in.u8();
+  if (mask & FIELD_CB) entry.cb = in.u8();
+  if (mask & FIELD_SC) entry.sc = in.u8();
+
+  // The CPU maps its PC through CB, so the physical address is never stored
+  entry.address = physical(entry.pc, entry.cb);
+
+  uint32_t &cached = code[code_slot(entry.address)];
+
+  if (mask & FIELD_BYTES)
+  {
+    cached = code_word(entry.bytes);
+  }
+  else
+  {
+    for (int i = 0; i < 4; i++)
+      entry.bytes[i] = cached >> (i * 8);
+  }
+
+  return !in.failed;
+}
+
+/**
+ * Block compression
+ *
+ * Sequences of a token (literal count << 4 | match length - 4), extra
+ * length bytes for either nibble at 15, the literals, then a 16-bit match
+ * offset. The final sequence only carries literals.
+ **/
+
+static const int HASH_BITS = 14;
+static const uint32_t MIN_MATCH = 4;
+static const uint32_t MAX_OFFSET = 0xFFFF;
+
+static inline uint32_t read32(const uint8_t *p)
+{
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t hash(uint32_t sequence)
+{
+  return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static inline uint8_t *put_length(uint8_t *out, uint32_t length)
+{
+  while (length >= 255)
+  {
+    *out++ = 255;
+    length -= 255;
+  }
+
+  *out++ = length;
+  return out;
+}
+
+static uint8_t *put_sequence(uint8_t *out, const uint8_t *literals, uint32_t literal_length, uint32_t offset, uint32_t match_length)
+{
+  uint32_t match_code = match_length ? match_length - MIN_MATCH : 0;
+  uint8_t *token = out++;
+
+  *token = ((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15);
+
+  if (literal_length >= 15)
+  {
+    out = put_length(out, literal_length - 15);
+  }
+
+  memcpy(out, literals, literal_length);
+  out += literal_length;
+
+  if (match_length)
+  {
+    out = put16(out, offset);
+
+    if (match_code >= 15)
+    {
+      out = put_length(out, match_code - 15);
+    }
+  }
+
+  return out;
+}
+
+uint32_t TraceFile::compress_bound(uint32_t size)
+{
+  return size + size / 255 + 16;
+}
+
+uint32_t TraceFile::compress(const uint8_t *input, uint32_t size, uint8_t *output)
+{
+  // Positions are stored plus one, so zero is an empty slot
+  uint32_t table[1 << HASH_BITS];
+  uint8_t *out = output;
+  uint32_t anchor = 0;
+  uint32_t position = 0;
+
+  memset(table, 0, sizeof(table));
+
+  while (position + MIN_MATCH <= size)
+  {
+    uint32_t sequence = read32(input + position);
+    uint32_t &slot = table[hash(sequence)];
+    uint32_t candidate = slot;
+
+    slot = position + 1;
+
+    if (!candidate || position - (candidate - 1) > MAX_OFFSET || read32(input + candidate - 1) != sequence)
+    {
+      position++;
+      continue;
+    }
+
+    candidate--;
+
+    uint32_t length = MIN_MATCH;
+    while (position + length < size && input[candidate + length] == input[position + length])
+    {
+      length++;
+    }
+
+    out = put_sequence(out, input + anchor, position - anchor, position - candidate, length);
+    position += length;
+    anchor = position;
+  }
+
+  out = put_sequence(out, input + anchor, size - anchor, 0, 0);
+  return out - output;
+}
+
+bool TraceFile::decompress(const uint8_t *input, uint32_t size, uint8_t *output, uint32_t capacity, uint32_t &written)
+{
+  uint32_t in = 0;
+  uint32_t out = 0;
+
+  auto length = [&](uint32_t value, bool &ok) {
+    if (value != 15)
+    {
+      return value;
+    }
+
+    uint8_t byte;
+    do
+    {
+      if (in >= size)
+      {
+        ok = false;
+        return value;
+      }
+
+      byte = input[in++];
+      value += byte;
+    } while (byte == 255);
+
+    return value;
+  };
+
+  while (in < size)
+  {
+    bool ok = true;
+    uint8_t token = input[in++];
+    uint32_t literals = length(token >> 4, ok);
+
+    if (!ok || literals > size - in || literals > capacity - out)
+    {
+      return false;
+    }
+
+    memcpy(output + out, input + in, literals);
+    in += literals;
+    out += literals;
+
+    if (in == size)
+    {
+      break;
+    }
+
+    if (size - in < 2)
+    {
+      return false;
+    }
+
+    uint32_t offset = input[in] | (input[in + 1] << 8);
+    in += 2;
+
+    uint32_t match = length(token & 15, ok) + MIN_MATCH;
+
+    if (!ok || offset == 0 || offset > out || match > capacity - out)
+    {
+      return false;
+    }
+
+    // Matches may overlap what they produce
+    for (uint32_t i = 0; i < match; i++, out++)
+    {
+      output[out] = output[out - offset];
+    }
+  }
+
+  written = out;
+  return true;
+}
+
+/**
+ * Writer
+ **/
+
+Writer::Writer()
+    : file(nullptr), failed(false), total(0), written(0), count(0), size(0), previous()
+{
+  encoded = (uint8_t *)malloc(BLOCK_CAPACITY);
+  compressed = (uint8_t *)malloc(compress_bound(BLOCK_CAPACITY));
+  code = (uint32_t *)calloc(1 << CODE_BITS, sizeof(uint32_t));
+}
+
+Writer::~Writer()
+{
+  close();
+
+  free(encoded);
+  free(compressed);
+  free(code);
+}
+
+bool Writer::open(const char *path)
+{
+  Header header = {};
+
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.entry_size = sizeof(Recorder::Entry);
+
+  file = fopen(path, "wb");
+  failed = !file || !encoded || !compressed || !code;
+
+  if (!failed)
+  {
+    failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    written = sizeof(header);
+  }
+
+  return !failed;
+}
+
+void Writer::append(const Recorder::Entry &entry)
+{
+  size = encode(encoded + size, entry, previous, code) - encoded;
+  previous = entry;
+  total++;
+
+  if (++count >= BLOCK_ENTRIES)
+  {
+    flush();
+  }
+}
+
+bool Writer::flush()
+{
+  if (!count)
+  {
+    return !failed;
+  }
+
+  BlockHeader block = {};
+  uint32_t packed = compress(encoded, size, compressed);
+
+  block.entries = count;
+  block.encoded_size = size;
+
+  // Blocks that do not compress are stored as they are
+  const uint8_t *data = (packed < size) ? compressed : encoded;
+  block.compressed_size = (packed < size) ? packed : size;
+
+  if (file && !failed)
+  {
+    failed = fwrite(&block, sizeof(block), 1, file) != 1 ||
+             fwrite(data, 1, block.compressed_size, file) != block.compressed_size;
+    written += sizeof(block) + block.compressed_size;
+  }
+
+  // Blocks decode on their own
+  count = 0;
+  size = 0;
+  previous = {};
+  memset(code, 0, sizeof(uint32_t) << CODE_BITS);
+
+  return !failed;
+}
+
+bool Writer::close()
+{
+  if (!file)
+  {
+    return !failed;
+  }
+
+  flush();
+  failed |= fclose(file) != 0;
+  file = nullptr;
+
+  return !failed;
+}
+
+/**
+ * Reader
+ **/
+
+Reader::Reader()
+    : file(nullptr), failed(false), total(0), remaining(0), cursor(0), size(0), previous()
+{
+  encoded = (uint8_t *)malloc(BLOCK_CAPACITY);
+  compressed = (uint8_t *)malloc(compress_bound(BLOCK_CAPACITY));
+  code = (uint32_t *)calloc(1 << CODE_BITS, sizeof(uint32_t));
+}
+
+Reader::~Reader()
+{
+  close();
+
+  free(encoded);
+  free(compressed);
+  free(code);
+}
+
+bool Reader::open(const char *path)
+{
+  Header header;
+
+  close();
+  file = fopen(path, "rb");
+  failed = !file || !encoded || !compressed || !code ||
+           fread(&header, sizeof(header), 1, file) != 1 ||
+           memcmp(header.magic, MAGIC, sizeof(MAGIC)) ||
+           header.version != VERSION;
+
+  total = 0;
+  remaining = 0;
+
+  return !failed;
+}
+
+void Reader::close()
+{
+  if (file)
+  {
+    fclose(file);
+    file = nullptr;
+  }
+}
+
+bool Reader::load()
+{
+  BlockHeader block;
+
+  if (fread(&block, sizeof(block), 1, file) != 1)
+  {
+    // A clean end of file is not an error
+    failed = !feof(file);
+    return false;
+  }
+
+  uint32_t written = block.compressed_size;
+
+  if (block.entries > BLOCK_ENTRIES || block.encoded_size > BLOCK_CAPACITY ||
+      block.compressed_size > compress_bound(BLOCK_CAPACITY) ||
+      fread(compressed, 1, block.compressed_size, file) != block.compressed_size)
+  {
+    failed = true;
+    return false;
+  }
+
+  if (block.compressed_size == block.encoded_size)
+  {
+    memcpy(encoded, compressed, block.encoded_size);
+  }
+  else if (!decompress(compressed, block.compressed_size, encoded, BLOCK_CAPACITY, written) || written != block.encoded_size)
+  {
+    failed = true;
+    return false;
+  }
+
+  remaining = block.entries;
+  cursor = 0;
+  size = block.encoded_size;
+  previous = {};
+  memset(code, 0, sizeof(uint32_t) << CODE_BITS);
+
+  return true;
+}
+
+bool Reader::next(Recorder::Entry &entry)
+{
+  if (!file || failed)
+  {
+    return false;
+  }
+
+  while (!remaining)
+  {
+    if (!load())
+    {
+      return false;
+    }
+  }
+
+  Cursor in = {encoded, cursor, size, false};
+
+  if (!decode(in, entry, previous, code))
+  {
+    failed = true;
+    return false;
+  }
+
+  cursor = in.position;
+  previous = entry;
+  remaining--;
+  total++;
+
+  return true;
+}
@@ -0,0 +1,121 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+/**
+ * Instruction trace files
+ *
+ * A file is a header followed by blocks of up to BLOCK_ENTRIES recorder
+ * entries. Each entry is stored as the fields that changed since the one
+ * before it, and each block is then LZ compressed on its own, so a reader
+ * can start at any block.
+ **/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "machine.h"
+
+namespace TraceFile
+{
+  static const char MAGIC[4] = {'P', 'M', 'I', 'T'};
+  static const uint32_t VERSION = 1;
+
+  static const uint32_t BLOCK_ENTRIES = 0x10000;
+
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_size; // sizeof(Recorder::Entry) of the writer
+    uint32_t reserved;
+  };
+
+  struct BlockHeader
+  {
+    uint32_t entries;
+    uint32_t encoded_size;    // Delta encoded bytes
+    uint32_t compressed_size; // Bytes that follow
+    uint32_t reserved;
+  };
+
+  class Writer
+  {
+  public:
+    Writer();
+    ~Writer();
+
+    bool open(const char *path);
+    void append(const Recorder::Entry &entry);
+    bool close();
+
+    uint64_t entries() const { return total; }
+    uint64_t bytes() const { return written; }
+
+  private:
+    bool flush();
+
+    FILE *file;
+    bool failed;
+    uint64_t total;
+    uint64_t written;
+
+    uint32_t count;
+    uint32_t size;
+    Recorder::Entry previous;
+    uint8_t *encoded;
+    uint8_t *compressed;
+    uint32_t *code; // Opcode bytes last seen at each PC, per block
+  };
+
+  class Reader
+  {
+  public:
+    Reader();
+    ~Reader();
+
+    bool open(const char *path);
+    bool next(Recorder::Entry &entry);
+    void close();
+
+    // Entries returned so far
+    uint64_t position() const { return total; }
+    bool error() const { return failed; }
+
+  private:
+    bool load();
+
+    FILE *file;
+    bool failed;
+    uint64_t total;
+
+    uint32_t remaining;
+    uint32_t cursor;
+    uint32_t size;
+    Recorder::Entry previous;
+    uint8_t *encoded;
+    uint8_t *compressed;
+    uint32_t *code;
+  };
+
+  // LZ77 with LZ4 style sequences, exposed for the tools that measure it
+  uint32_t compress(const uint8_t *input, uint32_t size, uint8_t *output);
+  bool decompress(const uint8_t *input, uint32_t size, uint8_t *output, uint32_t capacity, uint32_t &written);
+  uint32_t compress_bound(uint32_t size);
+}
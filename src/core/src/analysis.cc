@@ -0,0 +1,213 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+
+/**
+ * Static code discovery
+ *
+ * Recursive descent from the hardware vectors and cartridge jump slots.
+ * Each destination is followed once: the first path to reach an address in
+ * the unbanked area decides which bank its branches into the banked window
+ * resolve to.
+ **/
+
+// RAM and registers change at run time, so are never decoded
+static inline bool decodable(uint32_t address)
+{
+  return address < 0x1000 || (address >= 0x2100 && address < Analysis::ADDRESS_SPACE);
+}
+
+static void queue(Analysis::State &analysis, uint32_t address, int bank, uint8_t attribute)
+{
+  uint8_t &attributes = analysis.map[address];
+  bool seen = attributes & (Analysis::ATTR_CODE | Analysis::ATTR_BRANCH | Analysis::ATTR_CALL | Analysis::ATTR_ENTRY | Analysis::ATTR_PENDING);
+
+  if (!(attributes & (Analysis::ATTR_BRANCH | Analysis::ATTR_CALL | Analysis::ATTR_ENTRY)))
+  {
+    analysis.targets++;
+  }
+
+  attributes |= attribute;
+
+  if (seen || !decodable(address))
+  {
+    return;
+  }
+
+  if (analysis.depth >= Analysis::STACK_DEPTH)
+  {
+    // Picked up by a sweep of the map once the stack drains
+    attributes |= Analysis::ATTR_PENDING;
+    analysis.overflowed = true;
+    return;
+  }
+
+  analysis.stack[analysis.depth++] = {address, bank};
+}
+
+static bool overlaps(const Analysis::State &analysis, const Disassembler::Record &record)
+{
+  if (analysis.map[record.address] & Analysis::ATTR_OPERAND)
+  {
+    return true;
+  }
+
+  for (uint32_t i = 1; i < record.length; i++)
+  {
+    if (analysis.map[record.address + i] & (Analysis::ATTR_CODE | Analysis::ATTR_OPERAND))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Decodes a straight run of code, queueing every destination it can resolve
+static void walk(Machine::State &cpu, uint32_t address, int bank)
+{
+  Analysis::State &analysis = cpu.analysis;
+  const int home = (address >= 0x8000) ? Disassembler::default_bank(address) : bank;
+
+  while (decodable(address) && !(analysis.map[address] & Analysis::ATTR_CODE))
+  {
+    Disassembler::Record record;
+    Disassembler::decode(cpu, address, bank, record);
+
+    if ((record.flags & Disassembler::RECORD_UNDEFINED) || address + record.length > Analysis::ADDRESS_SPACE || overlaps(analysis, record))
+    {
+      analysis.map[address] |= Analysis::ATTR_CONFLICT;
+      analysis.conflicts++;
+      return;
+    }
+
+    analysis.map[address] |= Analysis::ATTR_CODE;
+    for (uint32_t i = 1; i < record.length; i++)
+    {
+      analysis.map[address + i] |= Analysis::ATTR_OPERAND;
+    }
+    analysis.instructions++;
+
+    if (record.flags & Disassembler::RECORD_BRANCH)
+    {
+      if (record.target == Disassembler::NO_TARGET)
+      {
+        analysis.unresolved++;
+      }
+      else
+      {
+        // The destination runs with CB loaded from NB
+        int target_bank = (record.target >= 0x8000) ? Disassembler::default_bank(record.target) : bank;
+        uint8_t attribute = (record.flags & Disassembler::RECORD_CALL) ? Analysis::ATTR_CALL : Analysis::ATTR_BRANCH;
+
+        queue(analysis, record.target, target_bank, attribute);
+      }
+    }
+
+    if (record.flags & Disassembler::RECORD_STOP)
+    {
+      return;
+    }
+
+    // After a control transfer, NB is back to the bank this run executes from
+    bank = Disassembler::next_bank(record, bank);
+    if (bank == Disassembler::BANK_UNKNOWN && !(record.flags & Disassembler::RECORD_SETS_BANK))
+    {
+      bank = home;
+    }
+
+    // The PC wraps within its 16-bit space, so runs never continue into the next bank
+    uint32_t next = address + record.length;
+    if ((next ^ address) & ~0x7FFF)
+    {
+      return;
+    }
+    address = next;
+  }
+}
+
+static void drain(Machine::State &cpu)
+{
+  Analysis::State &analysis = cpu.analysis;
+
+  while (analysis.depth > 0)
+  {
+    const Analysis::Work work = analysis.stack[--analysis.depth];
+    walk(cpu, work.address, work.bank);
+  }
+}
+
+extern "C" uint32_t analyze_code(Machine::State &cpu)
+{
+  Analysis::State &analysis = cpu.analysis;
+
+  memset(analysis.map, 0, sizeof(analysis.map));
+  analysis.instructions = 0;
+  analysis.targets = 0;
+  analysis.unresolved = 0;
+  analysis.conflicts = 0;
+  analysis.depth = 0;
+  analysis.overflowed = false;
+
+  // Hardware vectors always point into the unbanked area
+  for (int irq = 0; irq < IRQ::TOTAL_HARDWARE_IRQS; irq++)
+  {
+    uint32_t vector = 2 * irq;
+    uint16_t target = cpu.buffers.bios[vector] | (cpu.buffers.bios[vector + 1] << 8);
+
+    analysis.map[vector] |= Analysis::ATTR_VECTOR;
+    analysis.map[vector + 1] |= Analysis::ATTR_VECTOR;
+
+    if (target < 0x8000)
+    {
+      queue(analysis, target, Disassembler::BANK_UNKNOWN, Analysis::ATTR_ENTRY);
+    }
+  }
+
+  if (cpu.buffers.cartridge[0x2100] == 'M' && cpu.buffers.cartridge[0x2101] == 'N')
+  {
+    for (int slot = 0; slot < Analysis::CART_ENTRY_SLOTS; slot++)
+    {
+      queue(analysis, Analysis::CART_ENTRY + slot * Analysis::CART_ENTRY_STRIDE, Disassembler::BANK_UNKNOWN, Analysis::ATTR_ENTRY);
+    }
+  }
+
+  drain(cpu);
+
+  // Destinations that overflowed the stack are recovered from the map
+  while (analysis.overflowed)
+  {
+    analysis.overflowed = false;
+
+    for (uint32_t address = 0; address < Analysis::ADDRESS_SPACE; address++)
+    {
+      if (analysis.map[address] & Analysis::ATTR_PENDING)
+      {
+        analysis.map[address] &= ~Analysis::ATTR_PENDING;
+        walk(cpu, address, Disassembler::default_bank(address));
+        drain(cpu);
+      }
+    }
+  }
+
+  return analysis.instructions;
+}
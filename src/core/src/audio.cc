@@ -40,6 +40,7 @@ void Audio::setSampleRate(Audio::State &audio, int sampleRate)
 void Audio::clock(Machine::State &state, int osc3)
 {
   Audio::State &audio = state.audio;
+  Stats::Timer timer(state.stats, Stats::HOST_AUDIO);
 
   audio.sampleError += osc3 * audio.sampleRate;
   while (audio.sampleError > OSC3_SPEED)
@@ -75,6 +76,7 @@ void Audio::clock(Machine::State &state, int osc3)
     }
 
     state.buffers.audio[audio.write_index++] = audio.write_index; // volume;
+    state.stats.audio_samples++;
 
     if (audio.write_index >= AUDIO_BUFFER_LENGTH)
     {
@@ -18,6 +18,7 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include <string.h>
 #include "machine.h"
+#include "transpose.h"
 
 static const int SCREEN_WIDTH = 96;
 static const int SCREEN_HEIGHT = 64;
@@ -84,20 +85,270 @@ static inline uint16_t rev(uint16_t a)
   return a;
 }
 
-void Blitter::reset(Machine::State &cpu)
+// Where the blitter reads graphics from. Ranges wholly inside BIOS, RAM or
+// cartridge are read straight from host memory and traced here, anything
+// else and any read a watchpoint could see goes over the bus
+struct Source
 {
-  memset(&cpu.blitter, 0, sizeof(cpu.blitter));
+  const uint8_t *memory;
+  uint32_t base;
+  TraceType access;
+};
+
+static Source resolve(Machine::State &cpu, uint32_t base, uint32_t size, TraceType access)
+{
+  const uint32_t end = base + size;
+  const uint8_t *memory = nullptr;
+
+  if (cpu.debugger.watching)
+  {
+    memory = nullptr;
+  }
+  else if (end <= 0x1000)
+  {
+    memory = &cpu.buffers.bios[base];
+  }
+  else if (base >= 0x1000 && end <= 0x2000)
+  {
+    memory = &cpu.ram[base - 0x1000];
+  }
+  else if (base >= 0x2100 && end <= sizeof(cpu.buffers.cartridge) && Control::is_cart_enabled(cpu.ctrl))
+  {
+    memory = &cpu.buffers.cartridge[base];
+  }
+
+  return {memory, base, access};
 }
 
-void Blitter::clock(Machine::State &cpu)
+static inline uint8_t fetch(Machine::State &cpu, const Source &source, uint32_t offset)
 {
-  // Framerate divider
-  if (++cpu.blitter.divider < FRAME_DIVIDERS[cpu.blitter.frame_divider])
+  if (source.memory)
   {
-    return;
+    cpu_trace(cpu, source.base + offset, source.access | TRACE_READ);
+    return cpu.bus_cap = source.memory[offset];
   }
 
-  cpu.blitter.divider = 0;
+  return cpu_read8(cpu, source.base + offset, source.access);
+}
+
+static inline void draw_column(uint64_t &column, uint16_t cover, uint16_t ink, int dy)
+{
+  column &= ~shift(cover, dy);
+  column |= shift(ink, dy);
+}
+
+// Sprite graphics sit in 64 byte tiles, column x of half s reads offset
+// s * 32 + x and the three rows of eight after it. X flip reverses the
+// columns and swaps the halves
+static inline int sprite_offset(int column, bool xflip)
+{
+  return ((column / 8) * 32 + column % 8) ^ (xflip ? 0b0100111 : 0);
+}
+
+// Reads every visible column over the bus, in hardware order
+static void draw_fetched(Machine::State &cpu, FrameBuffer &target, const Source &source, uint8_t flags, int dx, int dy)
+{
+  bool xflip = flags & 0b0001;
+  bool yflip = flags & 0b0010;
+  bool invert = flags & 0b0100;
+
+  for (int column = 0; column < 16; column++, dx++)
+  {
+    // Offscreen
+    if (dx >= SCREEN_WIDTH)
+    {
+      break;
+    }
+    else if (dx < 0)
+    {
+      continue;
+    }
+
+    int offset = sprite_offset(column, xflip);
+    uint16_t mask = fetch(cpu, source, offset + 0) | (fetch(cpu, source, offset + 8) << 8);
+    uint16_t draw = fetch(cpu, source, offset + 16) | (fetch(cpu, source, offset + 24) << 8);
+
+    if (yflip)
+    {
+      mask = rev(mask);
+      draw = rev(draw);
+    }
+
+    if (invert)
+    {
+      draw = ~draw;
+    }
+
+    mask = ~mask;
+    draw_column(target.column[dx], mask, draw & mask, dy);
+  }
+}
+
+static uint32_t generation(const Machine::State &cpu, uint32_t address)
+{
+  return (address >= 0x1000 && address <= 0x1FFF) ? cpu.ram_generation[(address >> 8) & 0xF] : cpu.rom_generation;
+}
+
+static const Blitter::Sprite &decode(Machine::State &cpu, const Source &source, uint8_t tile, uint8_t flags)
+{
+  Blitter::Sprite &sprite = cpu.sprite_cache.sprites[flags & 0b11][tile];
+  uint32_t current = generation(cpu, source.base);
+
+  if (sprite.valid && sprite.address == source.base && sprite.generation == current)
+  {
+    return sprite;
+  }
+
+  for (int column = 0; column < 16; column++)
+  {
+    const uint8_t *bytes = &source.memory[sprite_offset(column, flags & 0b0001)];
+    uint16_t mask = bytes[0] | (bytes[8] << 8);
+    uint16_t draw = bytes[16] | (bytes[24] << 8);
+
+    if (flags & 0b0010)
+    {
+      mask = rev(mask);
+      draw = rev(draw);
+    }
+
+    sprite.cover[column] = ~mask;
+    sprite.ink[0][column] = draw & ~mask;
+    sprite.ink[1][column] = ~draw & ~mask;
+  }
+
+  sprite.address = source.base;
+  sprite.generation = current;
+  sprite.valid = true;
+
+  return sprite;
+}
+
+// Same result as draw_fetched, from graphics decoded on an earlier frame.
+// False when the sprite is wholly offscreen and nothing was read
+static bool draw_cached(Machine::State &cpu, FrameBuffer &target, const Source &source, uint8_t tile, uint8_t flags, int dx, int dy)
+{
+  const Blitter::Sprite &sprite = decode(cpu, source, tile, flags);
+  const uint16_t *ink = sprite.ink[(flags & 0b0100) ? 1 : 0];
+
+  int first = (dx < 0) ? -dx : 0;
+  int last = min(16, SCREEN_WIDTH - dx);
+
+  if (first >= last)
+  {
+    return false;
+  }
+
+  for (int column = first; column < last; column++)
+  {
+    draw_column(target.column[dx + column], sprite.cover[column], ink[column], dy);
+  }
+
+  // The trace sees the same bytes fetching the visible columns would
+  if (cpu.trace.enabled)
+  {
+    for (int column = first; column < last; column++)
+    {
+      int offset = sprite_offset(column, flags & 0b0001);
+
+      for (int row = 0; row < 32; row += 8)
+        cpu_trace(cpu, source.base + offset + row, source.access | TRACE_READ);
+    }
+  }
+
+  // The bus is left holding the last byte the hardware would have fetched
+  cpu.bus_cap = source.memory[sprite_offset(last - 1, flags & 0b0001) + 24];
+
+  return true;
+}
+
+// Bit n is set for RAM page n when the source is RAM read directly
+static uint16_t ram_pages(const Source &source, uint32_t size)
+{
+  if (!source.memory || source.base < 0x1000 || source.base >= 0x2000)
+  {
+    return 0;
+  }
+
+  const int first = (source.base >> 8) & 0xF;
+  const int last = ((source.base + size - 1) >> 8) & 0xF;
+
+  return ((2 << last) - 1) & ~((1 << first) - 1);
+}
+
+// Bit n is set for each trace bank the source overlaps
+static uint64_t trace_banks(const Source &source, uint32_t size)
+{
+  const int first = source.base >> Trace::BANK_BITS;
+  const int last = ((source.base + size - 1) & (Trace::ADDRESS_SPACE - 1)) >> Trace::BANK_BITS;
+
+  return ((2ull << last) - 1) & ~((1ull << first) - 1);
+}
+
+static bool same_registers(const Blitter::Inputs &inputs, const Blitter::State &blitter)
+{
+  return inputs.invert_map == blitter.invert_map &&
+         inputs.enable_map == blitter.enable_map &&
+         inputs.enable_sprites == blitter.enable_sprites &&
+         inputs.map_size == blitter.map_size &&
+         inputs.scroll_x == blitter.scroll_x &&
+         inputs.scroll_y == blitter.scroll_y &&
+         inputs.map_base == blitter.map_base &&
+         inputs.sprite_base == blitter.sprite_base;
+}
+
+// The framebuffer in RAM already holds what rendering would write
+static bool unchanged(Machine::State &cpu)
+{
+  const Blitter::Inputs &inputs = cpu.blitter_inputs;
+
+  if (!inputs.valid || cpu.debugger.watching)
+  {
+    return false;
+  }
+
+  // Reads are only left out of the trace while it still holds the last ones
+  if (cpu.trace.enabled && (!inputs.traced || (trace_changed_banks(cpu, inputs.trace_generation) & inputs.trace_banks)))
+  {
+    return false;
+  }
+
+  if (inputs.cart_enabled != Control::is_cart_enabled(cpu.ctrl) ||
+      inputs.rom_generation != cpu.rom_generation ||
+      !same_registers(inputs, cpu.blitter))
+  {
+    return false;
+  }
+
+  for (int page = 0; page < 0x10; page++)
+  {
+    if ((inputs.pages >> page) & 1 && inputs.ram_generation[page] != cpu.ram_generation[page])
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Blitter::reset(Machine::State &cpu)
+{
+  memset(&cpu.blitter, 0, sizeof(cpu.blitter));
+  cpu.blitter_inputs.valid = false;
+}
+
+static void render(Machine::State &cpu)
+{
+  Blitter::Inputs &inputs = cpu.blitter_inputs;
+
+  // The framebuffer is only read back with the map off, OAM and map always
+  const uint16_t framebuffer_pages = (1 << (sizeof(cpu.overlay.framebuffer) / 0x100)) - 1;
+  const uint16_t overlay_pages = (1 << ((sizeof(Blitter::Overlay) + 0xFF) / 0x100)) - 1;
+  uint16_t reads = overlay_pages & ~(cpu.blitter.enable_map ? framebuffer_pages : 0);
+  uint16_t writes = 0;
+  uint64_t banks = 0;
+
+  inputs.fetched = false;
+  bool direct = true;
 
   // Rendering loop
   FrameBuffer target;
@@ -111,6 +362,13 @@ void Blitter::clock(Machine::State &cpu)
     int y_fine = dy % 8;
     int y_tile = (dy / 8) * size.width;
 
+    const Source tiles = resolve(cpu, cpu.blitter.map_base, 0x100 * 8, TRACE_TILE_DATA);
+
+    reads |= ram_pages(tiles, 0x100 * 8);
+    banks |= trace_banks(tiles, 0x100 * 8);
+    inputs.fetched = true;
+    direct = direct && tiles.memory;
+
     for (int x = 0; x < SCREEN_WIDTH; x++, dx++)
     {
       int x_fine = dx % 8;
@@ -122,8 +380,7 @@ void Blitter::clock(Machine::State &cpu)
       for (int y = -y_fine; y < SCREEN_HEIGHT; y += 8, address += size.width)
       {
         uint8_t tile = cpu.overlay.map[address];
-        auto tile_address = cpu.blitter.map_base + x_fine + tile * 8;
-        uint8_t graphic = cpu_read8(cpu, tile_address, TRACE_TILE_DATA);
+        uint8_t graphic = fetch(cpu, tiles, x_fine + tile * 8);
 
         target.column[x] |= shift(graphic, y);
       }
@@ -137,12 +394,14 @@ void Blitter::clock(Machine::State &cpu)
   }
   else
   {
-    for (int x = 0; x < SCREEN_WIDTH; x++)
+    for (int x = 0; x < SCREEN_WIDTH; x += 8)
     {
       for (int y = 0; y < 8; y++)
       {
-        target.bytes[x][y] = cpu.overlay.framebuffer[y][x];
+        memcpy(&target.column[x + y], &cpu.overlay.framebuffer[y][x], 8);
       }
+
+      transpose8x8(&target.column[x]);
     }
   }
 
@@ -159,80 +418,106 @@ void Blitter::clock(Machine::State &cpu)
       uint8_t sprite_x = cpu.overlay.oam[i][0] & 0x7F;
       uint8_t sprite_y = cpu.overlay.oam[i][1] & 0x7F;
       uint8_t sprite_tile = cpu.overlay.oam[i][2];
-      bool sprite_xflip = sprite_flags & 0b0001;
-      bool sprite_yflip = sprite_flags & 0b0010;
-      bool sprite_invert = sprite_flags & 0b0100;
 
-      auto address = cpu.blitter.sprite_base + sprite_tile * (8 * 8);
       int dx = sprite_x - 16;
       int dy = sprite_y - 16;
 
-      int invert = sprite_xflip ? 0b0100111 : 0;
-
       if (dy <= -16 || dy >= SCREEN_HEIGHT)
         continue;
 
-      for (int s = 0; s < 2; s++)
+      const Source source = resolve(cpu, cpu.blitter.sprite_base + sprite_tile * (8 * 8), 8 * 8, TRACE_SPRITE_DATA);
+
+      if (source.memory)
+      {
+        reads |= ram_pages(source, 8 * 8);
+        banks |= trace_banks(source, 8 * 8);
+        inputs.fetched = draw_cached(cpu, target, source, sprite_tile, sprite_flags, dx, dy) || inputs.fetched;
+      }
+      else
       {
-        for (int x = 0; x < 8; x++, address++, dx++)
-        {
-          // Offscreen
-          if (dx >= SCREEN_WIDTH)
-          {
-            break;
-          }
-          else if (dx < 0)
-          {
-            continue;
-          }
-
-          uint16_t mask = cpu_read8(cpu, (address ^ invert) + 0, TRACE_SPRITE_DATA) | (cpu_read8(cpu, (address ^ invert) + 8, TRACE_SPRITE_DATA) << 8);
-          uint16_t draw = cpu_read8(cpu, (address ^ invert) + 16, TRACE_SPRITE_DATA) | (cpu_read8(cpu, (address ^ invert) + 24, TRACE_SPRITE_DATA) << 8);
-
-          if (sprite_yflip)
-          {
-            mask = rev(mask);
-            draw = rev(draw);
-          }
-
-          if (sprite_invert)
-          {
-            draw = ~draw;
-          }
-
-          mask = ~mask;
-          target.column[dx] &= ~shift(mask, dy);
-          target.column[dx] |= shift(draw & mask, dy);
-        }
-
-        address += 24;
+        draw_fetched(cpu, target, source, sprite_flags, dx, dy);
+        direct = false;
       }
     }
   }
 
-  // Copy back to ram
-  for (int x = 0; x < SCREEN_WIDTH; x++)
+  // Copy back to ram, pages that change go stale for anything decoded from them
+  uint8_t framebuffer[8][SCREEN_WIDTH];
+
+  for (int x = 0; x < SCREEN_WIDTH; x += 8)
   {
+    transpose8x8(&target.column[x]);
+
     for (int y = 0; y < 8; y++)
     {
-      cpu.overlay.framebuffer[y][x] = target.bytes[x][y];
+      memcpy(&framebuffer[y][x], &target.column[x + y], 8);
+    }
+  }
+
+  for (int page = 0; page < (int)sizeof(framebuffer) / 0x100; page++)
+  {
+    uint8_t *ram = &cpu.ram[page * 0x100];
+    const uint8_t *source = &framebuffer[0][0] + page * 0x100;
+
+    if (memcmp(ram, source, 0x100))
+    {
+      memcpy(ram, source, 0x100);
+      cpu.ram_generation[page]++;
+      writes |= 1 << page;
     }
   }
 
+  // Graphics read from the framebuffer change under the next frame
+  inputs.valid = direct && !(reads & writes);
+  inputs.pages = reads | framebuffer_pages;
+  inputs.cart_enabled = Control::is_cart_enabled(cpu.ctrl);
+  inputs.invert_map = cpu.blitter.invert_map;
+  inputs.enable_map = cpu.blitter.enable_map;
+  inputs.enable_sprites = cpu.blitter.enable_sprites;
+  inputs.map_size = cpu.blitter.map_size;
+  inputs.scroll_x = cpu.blitter.scroll_x;
+  inputs.scroll_y = cpu.blitter.scroll_y;
+  inputs.map_base = cpu.blitter.map_base;
+  inputs.sprite_base = cpu.blitter.sprite_base;
+  inputs.rom_generation = cpu.rom_generation;
+  inputs.bus_cap = cpu.bus_cap;
+  inputs.traced = cpu.trace.enabled;
+  inputs.trace_banks = banks;
+  inputs.trace_generation = cpu.trace.generation;
+  memcpy(inputs.ram_generation, cpu.ram_generation, sizeof(inputs.ram_generation));
+}
+
+void Blitter::clock(Machine::State &cpu)
+{
+  // Framerate divider
+  if (++cpu.blitter.divider < FRAME_DIVIDERS[cpu.blitter.frame_divider])
+  {
+    return;
+  }
+
+  cpu.blitter.divider = 0;
+  cpu.stats.blitter_frames++;
+
+  Stats::Timer timer(cpu.stats, Stats::HOST_BLITTER);
+
+  // A still screen is not composited again, only the bus sees the last read
+  if (!unchanged(cpu))
+  {
+    render(cpu);
+  }
+  else if (cpu.blitter_inputs.fetched)
+  {
+    cpu.bus_cap = cpu.blitter_inputs.bus_cap;
+  }
+
   // Send to LCD
   if (cpu.blitter.enable_copy)
   {
     IRQ::trigger(cpu, IRQ::IRQ_BLT_COPY);
 
-    for (int p = 0, a = 0; p < 8; p++)
+    for (int p = 0; p < 8; p++)
     {
-      LCD::write(cpu.lcd, 0b10110000 | p, 0x20FE);
-      LCD::write(cpu.lcd, 0b00000000, 0x20FE);
-      LCD::write(cpu.lcd, 0b00010000, 0x20FE);
-      for (int x = 0; x < SCREEN_WIDTH; x++)
-      {
-        LCD::write(cpu.lcd, cpu.ram[a++], 0x20FF);
-      }
+      LCD::write_page_block(cpu.lcd, p, &cpu.ram[p * SCREEN_WIDTH], SCREEN_WIDTH);
     }
   }
 
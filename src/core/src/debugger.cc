@@ -0,0 +1,530 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+
+void Debugger::reset(Machine::State &cpu)
+{
+  cpu.debugger.skip = false;
+  cpu.debugger.stop_reason = STOP_NONE;
+}
+
+void Debugger::resume_at(Machine::State &cpu, uint32_t address)
+{
+  cpu.debugger.skip = true;
+  cpu.debugger.resume_address = address & (ADDRESS_SPACE - 1);
+}
+
+/**
+ * Execution breakpoints
+ *
+ * One bit per byte of the physical address space, only consulted by
+ * cpu_advance while at least one bit is set.
+ **/
+
+static void stop(Debugger::State &debugger, Debugger::StopReason reason, uint32_t address)
+{
+  debugger.stop_reason = reason;
+  debugger.stop_address = address;
+  debugger.stop_watchpoint = -1;
+  debugger.stop_condition = -1;
+  debugger.stop_kind = 0;
+  debugger.stop_access = 0;
+  debugger.stop_value = 0;
+}
+
+static void update_armed(Debugger::State &debugger)
+{
+  debugger.armed = debugger.breakpoint_count > 0 || debugger.condition_count > 0 || (debugger.watch_kinds & Debugger::WATCH_EXECUTE);
+}
+
+static int find_watchpoint(const Debugger::State &debugger, uint32_t address, uint8_t kind)
+{
+  if (!(debugger.watch_pages[address >> Debugger::WATCH_PAGE_BITS] & kind))
+  {
+    return -1;
+  }
+
+  for (int i = 0; i < Debugger::WATCHPOINT_COUNT; i++)
+  {
+    const Debugger::Watchpoint &watch = debugger.watchpoints[i];
+
+    if ((watch.kinds & kind) && address >= watch.start && address <= watch.end)
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static inline bool is_breakpoint(const Debugger::State &debugger, uint32_t address)
+{
+  return (debugger.breakpoints[address >> 3] >> (address & 7)) & 1;
+}
+
+bool Debugger::break_at(Machine::State &cpu, uint32_t address)
+{
+  Debugger::State &debugger = cpu.debugger;
+  address &= ADDRESS_SPACE - 1;
+
+  if (debugger.skip)
+  {
+    debugger.skip = false;
+
+    if (address == debugger.resume_address)
+    {
+      return false;
+    }
+  }
+
+  // Conditions run even where a breakpoint stops, so their logpoints still log
+  bool condition = debugger.condition_pages[address >> WATCH_PAGE_BITS] && evaluate(cpu, address);
+
+  if (is_breakpoint(debugger, address))
+  {
+    stop(debugger, STOP_BREAKPOINT, address);
+  }
+  else if (condition)
+  {
+    // Stop details were filled in by evaluate
+  }
+  else if (debugger.watch_kinds & WATCH_EXECUTE)
+  {
+    int index = find_watchpoint(debugger, address, WATCH_EXECUTE);
+
+    if (index < 0)
+    {
+      return false;
+    }
+
+    stop(debugger, STOP_WATCHPOINT, address);
+    debugger.stop_watchpoint = index;
+    debugger.stop_kind = WATCH_EXECUTE;
+  }
+  else
+  {
+    return false;
+  }
+
+  resume_at(cpu, address);
+  return true;
+}
+
+extern "C" void breakpoint_set(Machine::State &cpu, uint32_t address)
+{
+  Debugger::State &debugger = cpu.debugger;
+  address &= Debugger::ADDRESS_SPACE - 1;
+
+  if (!is_breakpoint(debugger, address))
+  {
+    debugger.breakpoints[address >> 3] |= 1 << (address & 7);
+    debugger.breakpoint_count++;
+    update_armed(debugger);
+  }
+}
+
+extern "C" void breakpoint_clear(Machine::State &cpu, uint32_t address)
+{
+  Debugger::State &debugger = cpu.debugger;
+  address &= Debugger::ADDRESS_SPACE - 1;
+
+  if (is_breakpoint(debugger, address))
+  {
+    debugger.breakpoints[address >> 3] &= ~(1 << (address & 7));
+    debugger.breakpoint_count--;
+    update_armed(debugger);
+  }
+}
+
+/**
+ * Data watchpoints
+ *
+ * Checked from cpu_read8 and cpu_write8, which also carry the blitter's
+ * tile and sprite fetches. A hit is latched here and cpu_advance stops once
+ * the instruction (or blitter frame) that caused it has finished.
+ **/
+
+void Debugger::watch(Machine::State &cpu, uint32_t address, uint32_t access, uint8_t value)
+{
+  Debugger::State &debugger = cpu.debugger;
+  uint8_t kind = (access & TRACE_WRITE) ? WATCH_WRITE : WATCH_READ;
+
+  address &= ADDRESS_SPACE - 1;
+
+  // Keep the first hit of an instruction
+  if (debugger.stop_reason != STOP_NONE)
+  {
+    return;
+  }
+
+  int index = find_watchpoint(debugger, address, kind);
+
+  if (index < 0)
+  {
+    return;
+  }
+
+  stop(debugger, STOP_WATCHPOINT, address);
+  debugger.stop_watchpoint = index;
+  debugger.stop_kind = kind;
+  debugger.stop_access = access;
+  debugger.stop_value = value;
+}
+
+static void rebuild_watch_pages(Debugger::State &debugger)
+{
+  memset(debugger.watch_pages, 0, sizeof(debugger.watch_pages));
+  debugger.watch_kinds = 0;
+
+  for (int i = 0; i < Debugger::WATCHPOINT_COUNT; i++)
+  {
+    const Debugger::Watchpoint &watch = debugger.watchpoints[i];
+
+    if (!watch.kinds)
+    {
+      continue;
+    }
+
+    for (uint32_t page = watch.start >> Debugger::WATCH_PAGE_BITS; page <= watch.end >> Debugger::WATCH_PAGE_BITS; page++)
+    {
+      debugger.watch_pages[page] |= watch.kinds;
+    }
+
+    debugger.watch_kinds |= watch.kinds;
+  }
+
+  debugger.watching = (debugger.watch_kinds & (Debugger::WATCH_READ | Debugger::WATCH_WRITE)) != 0;
+  update_armed(debugger);
+}
+
+// Returns the watchpoint index, or -1 when every slot is in use
+extern "C" int watchpoint_set(Machine::State &cpu, uint32_t start, uint32_t end, uint8_t kinds)
+{
+  Debugger::State &debugger = cpu.debugger;
+
+  start &= Debugger::ADDRESS_SPACE - 1;
+  end &= Debugger::ADDRESS_SPACE - 1;
+
+  if (!kinds || start > end)
+  {
+    return -1;
+  }
+
+  for (int i = 0; i < Debugger::WATCHPOINT_COUNT; i++)
+  {
+    Debugger::Watchpoint &watch = debugger.watchpoints[i];
+
+    if (watch.kinds)
+    {
+      continue;
+    }
+
+    watch.start = start;
+    watch.end = end;
+    watch.kinds = kinds & (Debugger::WATCH_READ | Debugger::WATCH_WRITE | Debugger::WATCH_EXECUTE);
+
+    rebuild_watch_pages(debugger);
+    return i;
+  }
+
+  return -1;
+}
+
+extern "C" void watchpoint_clear(Machine::State &cpu, int index)
+{
+  if (index < 0 || index >= Debugger::WATCHPOINT_COUNT)
+  {
+    return;
+  }
+
+  cpu.debugger.watchpoints[index].kinds = 0;
+  rebuild_watch_pages(cpu.debugger);
+}
+
+/**
+ * Conditional breakpoints and logpoints
+ *
+ * Every condition at the PC is evaluated, so logpoints sharing an address
+ * with a breakpoint of either kind still log when it stops.
+ **/
+
+uint8_t Debugger::peek8(Machine::State &cpu, uint32_t address)
+{
+  return cpu_peek(cpu, address);
+}
+
+static int32_t read_register(Machine::State &cpu, uint8_t reg)
+{
+  switch (reg)
+  {
+  case Debugger::REG_A: return cpu.reg.a;
+  case Debugger::REG_B: return cpu.reg.b;
+  case Debugger::REG_L: return cpu.reg.l;
+  case Debugger::REG_H: return cpu.reg.h;
+  case Debugger::REG_BA: return cpu.reg.ba;
+  case Debugger::REG_HL: return cpu.reg.hl;
+  case Debugger::REG_IX: return cpu.reg.ix;
+  case Debugger::REG_IY: return cpu.reg.iy;
+  case Debugger::REG_SP: return cpu.reg.sp;
+  case Debugger::REG_PC: return cpu.reg.pc;
+  case Debugger::REG_BR: return cpu.reg.br;
+  case Debugger::REG_EP: return cpu.reg.ep;
+  case Debugger::REG_XP: return cpu.reg.xp;
+  case Debugger::REG_YP: return cpu.reg.yp;
+  case Debugger::REG_NB: return cpu.reg.nb;
+  case Debugger::REG_CB: return cpu.reg.cb;
+  case Debugger::REG_SC: return cpu_readSC(cpu);
+  case Debugger::REG_PHYSICAL_PC: return calc_pc(cpu);
+  default: return 0;
+  }
+}
+
+// Malformed programs evaluate to true, so a broken condition still stops
+static int32_t malformed(Debugger::State &debugger)
+{
+  debugger.condition_error = true;
+  return 1;
+}
+
+static int32_t run(Machine::State &cpu, int slot)
+{
+  Debugger::State &debugger = cpu.debugger;
+  const Debugger::Condition &condition = debugger.conditions[slot];
+  const uint8_t *program = condition.program;
+
+  int32_t stack[Debugger::EVAL_STACK_DEPTH];
+  int depth = 0;
+  int item = 0;
+  int pc = 0;
+
+  while (pc < Debugger::PROGRAM_LENGTH)
+  {
+    uint8_t op = program[pc++];
+
+    // Every operation leaves at most one more value than it takes
+    if (depth >= Debugger::EVAL_STACK_DEPTH)
+    {
+      return malformed(debugger);
+    }
+
+    // Binary operators
+    if (op >= Debugger::OP_ADD && op <= Debugger::OP_LOR)
+    {
+      if (depth < 2)
+      {
+        return malformed(debugger);
+      }
+
+      int32_t b = stack[--depth];
+      int32_t &a = stack[depth - 1];
+
+      switch (op)
+      {
+      case Debugger::OP_ADD: a = (uint32_t)a + (uint32_t)b; break;
+      case Debugger::OP_SUB: a = (uint32_t)a - (uint32_t)b; break;
+      case Debugger::OP_AND: a = a & b; break;
+      case Debugger::OP_OR: a = a | b; break;
+      case Debugger::OP_XOR: a = a ^ b; break;
+      case Debugger::OP_SHL: a = (uint32_t)a << (b & 31); break;
+      case Debugger::OP_SHR: a = (uint32_t)a >> (b & 31); break;
+      case Debugger::OP_EQ: a = a == b; break;
+      case Debugger::OP_NE: a = a != b; break;
+      case Debugger::OP_LT: a = a < b; break;
+      case Debugger::OP_LE: a = a <= b; break;
+      case Debugger::OP_GT: a = a > b; break;
+      case Debugger::OP_GE: a = a >= b; break;
+      case Debugger::OP_LAND: a = a && b; break;
+      case Debugger::OP_LOR: a = a || b; break;
+      }
+
+      continue;
+    }
+
+    switch (op)
+    {
+    case Debugger::OP_END:
+      return depth ? stack[depth - 1] : 0;
+    case Debugger::OP_PUSH:
+      if (pc + 4 > Debugger::PROGRAM_LENGTH)
+      {
+        return malformed(debugger);
+      }
+
+      stack[depth++] = (uint32_t)program[pc] | ((uint32_t)program[pc + 1] << 8) | ((uint32_t)program[pc + 2] << 16) | ((uint32_t)program[pc + 3] << 24);
+      pc += 4;
+      continue;
+    case Debugger::OP_REG:
+      if (pc >= Debugger::PROGRAM_LENGTH)
+      {
+        return malformed(debugger);
+      }
+
+      stack[depth++] = read_register(cpu, program[pc++]);
+      continue;
+    case Debugger::OP_HITS:
+      stack[depth++] = condition.hits;
+      continue;
+    case Debugger::OP_JZ:
+      if (depth < 1 || pc >= Debugger::PROGRAM_LENGTH)
+      {
+        return malformed(debugger);
+      }
+
+      pc += stack[--depth] ? 1 : 1 + program[pc];
+      continue;
+    }
+
+    // Unary operators
+    if (depth < 1)
+    {
+      return malformed(debugger);
+    }
+
+    int32_t &a = stack[depth - 1];
+
+    switch (op)
+    {
+    case Debugger::OP_READ8:
+      a = Debugger::peek8(cpu, a);
+      continue;
+    case Debugger::OP_READ16:
+      a = Debugger::peek8(cpu, a) | (Debugger::peek8(cpu, (((uint32_t)a + 1) & 0xFFFF) | (a & 0xFF0000)) << 8);
+      continue;
+    case Debugger::OP_NOT:
+      a = !a;
+      continue;
+    case Debugger::OP_NEG:
+      a = -(uint32_t)a;
+      continue;
+    case Debugger::OP_LOG:
+    {
+      int32_t value = stack[--depth];
+
+      // Re-executed history was already logged the first time through
+      if (cpu.rewind.replaying)
+      {
+        continue;
+      }
+
+      Debugger::LogEntry &entry = debugger.log[debugger.log_index++ % Debugger::LOG_COUNT];
+
+      entry.address = condition.address;
+      entry.condition = slot;
+      entry.item = item++;
+      entry.value = value;
+      continue;
+    }
+    }
+
+    return malformed(debugger);
+  }
+
+  return malformed(debugger);
+}
+
+bool Debugger::evaluate(Machine::State &cpu, uint32_t address)
+{
+  Debugger::State &debugger = cpu.debugger;
+  bool stopped = false;
+
+  for (int i = 0; i < CONDITION_COUNT; i++)
+  {
+    Condition &condition = debugger.conditions[i];
+
+    if (condition.kind == CONDITION_UNUSED || condition.address != address)
+    {
+      continue;
+    }
+
+    condition.hits++;
+
+    if (run(cpu, i) && condition.kind == CONDITION_BREAK && !stopped)
+    {
+      stop(debugger, STOP_CONDITION, address);
+      debugger.stop_condition = i;
+      stopped = true;
+    }
+  }
+
+  return stopped;
+}
+
+static void rebuild_condition_pages(Debugger::State &debugger)
+{
+  memset(debugger.condition_pages, 0, sizeof(debugger.condition_pages));
+  debugger.condition_count = 0;
+
+  for (int i = 0; i < Debugger::CONDITION_COUNT; i++)
+  {
+    const Debugger::Condition &condition = debugger.conditions[i];
+
+    if (condition.kind != Debugger::CONDITION_UNUSED)
+    {
+      debugger.condition_pages[condition.address >> Debugger::WATCH_PAGE_BITS] = 1;
+      debugger.condition_count++;
+    }
+  }
+
+  update_armed(debugger);
+}
+
+// Installs the program in program_buffer, returns the slot or -1 when full
+extern "C" int condition_set(Machine::State &cpu, uint32_t address, uint8_t kind)
+{
+  Debugger::State &debugger = cpu.debugger;
+
+  if (kind != Debugger::CONDITION_BREAK && kind != Debugger::CONDITION_LOG)
+  {
+    return -1;
+  }
+
+  for (int i = 0; i < Debugger::CONDITION_COUNT; i++)
+  {
+    Debugger::Condition &condition = debugger.conditions[i];
+
+    if (condition.kind != Debugger::CONDITION_UNUSED)
+    {
+      continue;
+    }
+
+    condition.kind = (Debugger::ConditionKind)kind;
+    condition.address = address & (Debugger::ADDRESS_SPACE - 1);
+    condition.hits = 0;
+    memcpy(condition.program, debugger.program_buffer, sizeof(condition.program));
+
+    rebuild_condition_pages(debugger);
+    return i;
+  }
+
+  return -1;
+}
+
+extern "C" void condition_clear(Machine::State &cpu, int slot)
+{
+  if (slot < 0 || slot >= Debugger::CONDITION_COUNT)
+  {
+    return;
+  }
+
+  cpu.debugger.conditions[slot].kind = Debugger::CONDITION_UNUSED;
+  rebuild_condition_pages(cpu.debugger);
+}
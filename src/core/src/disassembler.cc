@@ -0,0 +1,208 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+
+#include "machine.h"
+#include "opcodes.h"
+
+using namespace Disassembler;
+
+static uint8_t fetch(Machine::State &cpu, uint32_t address)
+{
+  // Show the cartridge contents even while it is not mapped in
+  if (address >= 0x2100)
+  {
+    return cpu.buffers.cartridge[address % sizeof(cpu.buffers.cartridge)];
+  }
+
+  return Debugger::peek8(cpu, address);
+}
+
+// PC value the CPU holds while executing from a physical address
+static inline uint16_t logical(uint32_t address)
+{
+  return (address < 0x8000) ? address : (0x8000 | (address & 0x7FFF));
+}
+
+static inline uint32_t physical(uint16_t address, int bank)
+{
+  if (~address & 0x8000)
+  {
+    return address;
+  }
+
+  return (bank == BANK_UNKNOWN) ? NO_TARGET : ((bank << 15) | (address & 0x7FFF));
+}
+
+static uint16_t operand(Machine::State &cpu, uint8_t argument, uint32_t &cursor)
+{
+  switch (argument)
+  {
+  case ARGUMENT_IMM_8:
+  case ARGUMENT_MEM_BR:
+  case ARGUMENT_MEM_VECTOR:
+    return fetch(cpu, cursor++);
+  case ARGUMENT_MEM_SP_DISP:
+  case ARGUMENT_MEM_IX_DISP:
+  case ARGUMENT_MEM_IY_DISP:
+  case ARGUMENT_REL_8:
+    return (int8_t)fetch(cpu, cursor++);
+  case ARGUMENT_IMM_16:
+  case ARGUMENT_MEM_ABS16:
+  case ARGUMENT_REL_16:
+  {
+    uint16_t value = fetch(cpu, cursor++);
+    return value | (fetch(cpu, cursor++) << 8);
+  }
+  default:
+    return 0;
+  }
+}
+
+int Disassembler::default_bank(uint32_t address)
+{
+  return (address >= 0x8000) ? (address >> 15) : BANK_UNKNOWN;
+}
+
+void Disassembler::decode(Machine::State &cpu, uint32_t address, int bank, Record &record)
+{
+  uint32_t cursor = address;
+  uint16_t opcode = fetch(cpu, cursor++);
+
+  // Expansion codes select the second and third tables
+  if (opcode == 0xCE || opcode == 0xCF)
+  {
+    opcode = ((opcode - 0xCD) << 8) | fetch(cpu, cursor++);
+  }
+
+  const Opcode &entry = OPCODES[opcode];
+
+  record.address = address;
+  record.target = NO_TARGET;
+  record.opcode = opcode;
+  record.operation = entry.operation;
+  record.condition = entry.condition;
+  record.flags = 0;
+
+  uint16_t displacement = 0;
+
+  for (int i = 0; i < 2; i++)
+  {
+    record.arguments[i] = entry.arguments[i];
+    record.operands[i] = operand(cpu, entry.arguments[i], cursor);
+
+    if (entry.arguments[i] == ARGUMENT_REL_8 || entry.arguments[i] == ARGUMENT_REL_16)
+    {
+      displacement = record.operands[i];
+    }
+  }
+
+  record.length = cursor - address;
+
+  // Relative branches are taken from the last byte of the instruction
+  uint16_t relative = logical(address) + record.length - 1 + displacement;
+
+  switch (entry.operation)
+  {
+  case OPERATION_NDEF:
+    record.flags = RECORD_UNDEFINED | RECORD_STOP;
+    break;
+  case OPERATION_JRS:
+  case OPERATION_JRL:
+    record.flags = RECORD_BRANCH | (entry.condition == CONDITION_NONE ? RECORD_STOP : 0);
+    record.target = physical(relative, bank);
+    break;
+  case OPERATION_DJR:
+    record.flags = RECORD_BRANCH;
+    record.target = physical(relative, bank);
+    break;
+  case OPERATION_CARS:
+  case OPERATION_CARL:
+    record.flags = RECORD_BRANCH | RECORD_CALL;
+    record.target = physical(relative, bank);
+    break;
+  case OPERATION_JP:
+    record.flags = RECORD_BRANCH | RECORD_STOP;
+
+    // JP HL is only known at run time, vectors live in the BIOS
+    if (entry.arguments[0] == ARGUMENT_MEM_VECTOR)
+    {
+      uint8_t vector = record.operands[0];
+      record.target = physical(fetch(cpu, vector) | (fetch(cpu, vector + 1) << 8), bank);
+    }
+    break;
+  case OPERATION_INT:
+  {
+    uint8_t vector = record.operands[0];
+    record.flags = RECORD_BRANCH | RECORD_CALL;
+    record.target = physical(fetch(cpu, vector) | (fetch(cpu, vector + 1) << 8), bank);
+    break;
+  }
+  case OPERATION_CALL:
+    // Reads its destination through EP, which is only known at run time
+    record.flags = RECORD_BRANCH | RECORD_CALL;
+    break;
+  case OPERATION_RET:
+  case OPERATION_RETE:
+  case OPERATION_RETS:
+    record.flags = RECORD_RETURN | RECORD_STOP;
+    break;
+  case OPERATION_LD:
+    if (entry.arguments[0] == ARGUMENT_REG_NB)
+    {
+      record.flags = RECORD_SETS_BANK;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+int Disassembler::next_bank(const Record &record, int bank)
+{
+  if (record.flags & RECORD_SETS_BANK)
+  {
+    return (record.arguments[1] == ARGUMENT_IMM_8) ? record.operands[1] : BANK_UNKNOWN;
+  }
+
+  // A control transfer consumes the loaded bank, code after it runs with NB == CB
+  if (record.flags & (RECORD_BRANCH | RECORD_RETURN | RECORD_UNDEFINED))
+  {
+    return default_bank(record.address + record.length);
+  }
+
+  return bank;
+}
+
+extern "C" uint32_t disassemble(Machine::State &cpu, uint32_t address, uint32_t count, Disassembler::Record *out)
+{
+  int bank = default_bank(address);
+  uint32_t written = 0;
+
+  while (written < count && address < Debugger::ADDRESS_SPACE)
+  {
+    Record &record = out[written++];
+
+    decode(cpu, address, bank, record);
+    bank = next_bank(record, bank);
+    address += record.length;
+  }
+
+  return written;
+}
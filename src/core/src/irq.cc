@@ -58,6 +58,9 @@ void IRQ::reset(Machine::State& cpu) {
 }
 
 static inline void fire(Machine::State& cpu, Vector irq, uint8_t priority) {
+	uint32_t site = calc_pc(cpu);
+
+	cpu.stats.irqs[irq]++;
 	cpu.status = Machine::STATUS_NORMAL;
 
 	cpu_push8(cpu, cpu.reg.cb);
@@ -68,7 +71,8 @@ static inline void fire(Machine::State& cpu, Vector irq, uint8_t priority) {
 	cpu.reg.pc = cpu_read16(cpu, 2 * (int) irq, TRACE_VECTOR);
 	cpu.reg.flag.i = priority;
 
-	trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+	profile_enter(cpu, site);
+	cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 void IRQ::manage(Machine::State& cpu) {
@@ -21,45 +21,270 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "machine.h"
 #include "debug.h"
+#include "transpose.h"
 
 void LCD::reset(LCD::State &lcd)
 {
   memset(&lcd, 0, sizeof(lcd));
 }
 
-static inline void fill(uint8_t *target, uint8_t color)
+static inline uint64_t load64(const uint8_t *source)
 {
-  for (int i = LCD_WIDTH; i > 0; i--)
+  uint64_t value;
+  memcpy(&value, source, sizeof(value));
+  return value;
+}
+
+// Bit n of each of eight bytes, packed with byte i at bit i (or 7 - i)
+static inline uint8_t gather(const uint8_t *bytes, int n)
+{
+  return ((load64(bytes) >> n) & 0x0101010101010101ull) * 0x0102040810204080ull >> 56;
+}
+
+static inline uint8_t gather_reversed(const uint8_t *bytes, int n)
+{
+  return ((load64(bytes) >> n) & 0x0101010101010101ull) * 0x8040201008040201ull >> 56;
+}
+
+// Every row has to scan its source again
+static void invalidate(LCD::State &lcd)
+{
+  for (auto &changes : lcd.page_changes)
   {
-    *(target++) = (*target >> 1) | color;
+    changes++;
+  }
+}
+
+template <typename T>
+static inline void set_control(LCD::State &lcd, T &field, T value)
+{
+  if (field != value)
+  {
+    field = value;
+    invalidate(lcd);
   }
 }
 
 static void render(Machine::Buffers &buffers, LCD::State &lcd, uint8_t com)
 {
-  uint8_t *line = buffers.lcd_shift[lcd.reverse_com_scan ? (63 - com) : com];
+  LCD::History &history = buffers.lcd_history;
+  int row = lcd.reverse_com_scan ? (63 - com) : com;
+  int drawline = (com + lcd.start_address) % 0x40;
+  int page = drawline / 8;
+  int head = history.head[row] = (history.head[row] - 1) & (LCD::HISTORY_FRAMES - 1);
+
+  if (lcd.row_page[row] != page || lcd.row_changes[row] != lcd.page_changes[page])
+  {
+    lcd.row_page[row] = page;
+    lcd.row_changes[row] = lcd.page_changes[page];
+    lcd.row_repeats[row] = 0;
+  }
+  else if (lcd.row_repeats[row] >= LCD::HISTORY_FRAMES)
+  {
+    // Every plane already holds what this scan would write
+    return;
+  }
+
+  lcd.row_repeats[row]++;
+
+  uint8_t *plane = history.planes[row][head];
 
   if (!lcd.display_enable)
   {
-    fill(line, 0x00);
+    memset(plane, 0x00, LCD::ROW_BYTES);
     return;
   }
   else if (lcd.all_on)
   {
-    fill(line, 0x80);
+    memset(plane, 0xFF, LCD::ROW_BYTES);
     return;
   }
 
-  int drawline = (com + lcd.start_address) % 0x40;
-  uint8_t mask = 1 << (drawline % 8);
-  uint8_t *current_page = lcd.gddram[drawline / 8];
+  int bit = drawline % 8;
+  const uint8_t *current_page = lcd.gddram[page];
+
+  if (lcd.adc_select)
+  {
+    // Pixel x shows column 131 - x, so each group is read backwards
+    for (int i = 0; i < LCD::ROW_BYTES; i++)
+    {
+      plane[i] = gather_reversed(&current_page[124 - i * 8], bit);
+    }
+  }
+  else
+  {
+    for (int i = 0; i < LCD::ROW_BYTES; i++)
+    {
+      plane[i] = gather(&current_page[i * 8], bit);
+    }
+  }
+}
+
+// Per pixel history of a row, newest frame in bit 7
+static void shades(const LCD::History &history, int row, uint8_t *target)
+{
+  uint64_t lo[LCD::HISTORY_FRAMES];
+  uint64_t hi[LCD::HISTORY_FRAMES];
+
+  // Oldest plane first, so that after transposing the newest lands in bit 7
+  for (int age = 0; age < LCD::HISTORY_FRAMES; age++)
+  {
+    const uint8_t *plane = history.planes[row][(history.head[row] + age) % LCD::HISTORY_FRAMES];
+    uint32_t upper;
+
+    memcpy(&lo[7 - age], plane, sizeof(uint64_t));
+    memcpy(&upper, plane + sizeof(uint64_t), sizeof(upper));
+    hi[7 - age] = upper;
+  }
+
+  // Group i of eight pixels now sits in word i, one byte per frame
+  transpose8x8(lo);
+  transpose8x8(hi);
+
+  for (int i = 0; i < LCD::ROW_BYTES; i++)
+  {
+    uint64_t group = transpose_bits((i < 8) ? lo[i] : hi[i - 8]);
+    memcpy(target + i * 8, &group, sizeof(group));
+  }
+}
+
+// Fold the blend weights, the contrast and the palette into one lookup
+static void build_colors(const Machine::Buffers &buffers, LCD::Colors &colors, uint8_t volume)
+{
+  const float lo = (volume <= 0x20) ? 0.0f : (volume - 0x20) / 31.0f;
+  const float hi = (volume >= 0x20) ? 1.0f : volume / 31.0f;
+
+  const float range = hi - lo;
+
+  for (int i = 0; i < 0x100; i++)
+  {
+    float weight = buffers.weights[i] * range + lo;
+    int color = (int)(256.0f * weight);
+    uint8_t level = color > 0xFF ? 0xFF : color;
+    uint32_t rgba = buffers.palette[level];
+
+    colors.lut[i] = rgba;
+    colors.intensity[i] = level;
+    colors.rgb565[i] = ((rgba << 8) & 0xF800) | ((rgba >> 5) & 0x07E0) | ((rgba >> 19) & 0x001F);
+  }
+
+  colors.volume = volume;
+  colors.valid = true;
+}
+
+// The host calls this after rewriting the weights or palette buffers
+extern "C" void palette_changed(Machine::State &cpu)
+{
+  cpu.colors.valid = false;
+}
+
+static inline bool stale_colors(const Machine::State &cpu)
+{
+  return !cpu.colors.valid || cpu.colors.volume != cpu.frame.volume;
+}
+
+static inline void update_colors(Machine::State &cpu)
+{
+  if (stale_colors(cpu))
+  {
+    build_colors(cpu.buffers, cpu.colors, cpu.frame.volume);
+  }
+}
+
+// Convert the last completed frame into the framebuffer. Bit y of the result
+// is set when row y changed colour, zero when the output was already current
+extern "C" uint64_t get_frame(Machine::State &cpu, LCD::FrameFormat format)
+{
+  if (format != LCD::FRAME_RGBA32)
+  {
+    return 0;
+  }
+
+  Stats::Timer timer(cpu.stats, Stats::HOST_LCD);
+  LCD::Frame &frame = cpu.frame;
 
-  for (int x = 0; x < LCD_WIDTH; x++)
+  if (frame.converted == frame.sequence && !stale_colors(cpu))
   {
-    uint8_t byte = current_page[lcd.adc_select ? 131 - x : x];
+    return 0;
+  }
+
+  update_colors(cpu);
+
+  const uint32_t *lut = cpu.colors.lut;
+  uint64_t dirty = 0;
+
+  for (int y = 0; y < LCD_HEIGHT; y++)
+  {
+    uint8_t line[LCD_WIDTH];
+    uint32_t colors[LCD_WIDTH];
+
+    shades(frame.history, y, line);
+
+    for (int x = 0; x < LCD_WIDTH; x++)
+    {
+      colors[x] = lut[line[x]];
+    }
+
+    if (memcmp(cpu.buffers.framebuffer[y], colors, sizeof(colors)))
+    {
+      memcpy(cpu.buffers.framebuffer[y], colors, sizeof(colors));
+      dirty |= 1ull << y;
+    }
+  }
+
+  frame.converted = frame.sequence;
+  return dirty;
+}
+
+// Write the last completed frame to target in any format, whether or not it
+// changed. Returns the frame sequence number, zero for an unknown format
+extern "C" uint32_t read_frame(Machine::State &cpu, LCD::FrameFormat format, uint8_t *target)
+{
+  Stats::Timer timer(cpu.stats, Stats::HOST_LCD);
+  const LCD::Frame &frame = cpu.frame;
+
+  if (format == LCD::FRAME_1BPP)
+  {
+    for (int y = 0; y < LCD_HEIGHT; y++)
+    {
+      memcpy(target, frame.history.planes[y][frame.history.head[y]], LCD::ROW_BYTES);
+      target += LCD::ROW_BYTES;
+    }
+
+    return frame.sequence;
+  }
+
+  update_colors(cpu);
+
+  for (int y = 0; y < LCD_HEIGHT; y++)
+  {
+    uint8_t line[LCD_WIDTH];
+
+    shades(frame.history, y, line);
 
-    *(line++) = (*line >> 1) | (((byte & mask) != 0) ? 0x80 : 0x00);
+    switch (format)
+    {
+    case LCD::FRAME_RGBA32:
+      for (int x = 0; x < LCD_WIDTH; x++, target += sizeof(uint32_t))
+        memcpy(target, &cpu.colors.lut[line[x]], sizeof(uint32_t));
+      break;
+
+    case LCD::FRAME_INTENSITY8:
+      for (int x = 0; x < LCD_WIDTH; x++)
+        *(target++) = cpu.colors.intensity[line[x]];
+      break;
+
+    case LCD::FRAME_RGB565:
+      for (int x = 0; x < LCD_WIDTH; x++, target += sizeof(uint16_t))
+        memcpy(target, &cpu.colors.rgb565[line[x]], sizeof(uint16_t));
+      break;
+
+    default:
+      return 0;
+    }
   }
+
+  return frame.sequence;
 }
 
 void LCD::clock(Machine::State &cpu, int osc3)
@@ -75,28 +300,25 @@ void LCD::clock(Machine::State &cpu, int osc3)
 
     if (cpu.lcd.scanline < 0x40)
     {
+      Stats::Timer timer(cpu.stats, Stats::HOST_LCD);
+
       render(cpu.buffers, cpu.lcd, cpu.lcd.scanline);
+      cpu.stats.scanlines++;
     }
     else
     {
-      uint32_t *framebuffer = &cpu.buffers.framebuffer[0][0];
-      const uint8_t *lcd_shift = &cpu.buffers.lcd_shift[0][0];
-
-      static uint8_t volume = 0;
-      const float lo = (volume <= 0x20) ? 0.0f : (volume - 0x20) / 31.0f;
-      const float hi = (volume >= 0x20) ? 1.0f : volume / 31.0f;
-
-      const float range = hi - lo;
-
-      for (int i = LCD_WIDTH * LCD_HEIGHT; i; i--)
       {
-        float weight = cpu.buffers.weights[*(lcd_shift++)] * range + lo;
-        int color = (int)(256.0f * weight);
-        *(framebuffer++) = cpu.buffers.palette[color > 0xFF ? 0xFF : color];
+        Stats::Timer timer(cpu.stats, Stats::HOST_LCD);
+
+        // Later scanlines overwrite the planes this frame still shows
+        cpu.frame.history = cpu.buffers.lcd_history;
+        cpu.frame.volume = cpu.lcd.frame_volume;
+        cpu.frame.sequence++;
       }
 
+      cpu.stats.frames++;
       Blitter::clock(cpu);
-      volume = cpu.lcd.volume;
+      cpu.lcd.frame_volume = cpu.lcd.volume;
     }
 
     cpu.lcd.overflow -= OSC3_SPEED;
@@ -130,6 +352,12 @@ uint8_t LCD::read(LCD::State &lcd, uint32_t address)
   }
 }
 
+// What read would return, without moving the column address
+uint8_t LCD::peek(const LCD::State &lcd, uint32_t address)
+{
+  return (address == 0x20FE) ? 0 : lcd.gddram[lcd.page_address][lcd.column_address];
+}
+
 void LCD::write(LCD::State &lcd, uint8_t data, uint32_t address)
 {
   lcd.read_buffer = data;
@@ -147,11 +375,11 @@ void LCD::write(LCD::State &lcd, uint8_t data, uint32_t address)
     {
     case 0b10101110:
     case 0b10101111:
-      lcd.display_enable = data & 1;
+      set_control(lcd, lcd.display_enable, (bool)(data & 1));
       break;
 
     case 0b01000000 ... 0b01111111:
-      lcd.start_address = data & 0b111111;
+      set_control(lcd, lcd.start_address, (uint8_t)(data & 0b111111));
       break;
 
     case 0b00000000 ... 0b00001111:
@@ -184,7 +412,7 @@ void LCD::write(LCD::State &lcd, uint8_t data, uint32_t address)
       break;
 
     case 0b10100000 ... 0b10100001:
-      lcd.adc_select = data & 1;
+      set_control(lcd, lcd.adc_select, (bool)(data & 1));
       break;
 
     case 0b10100110 ... 0b10100111:
@@ -192,7 +420,7 @@ void LCD::write(LCD::State &lcd, uint8_t data, uint32_t address)
       break;
 
     case 0b10100100 ... 0b10100101:
-      lcd.all_on = data & 1;
+      set_control(lcd, lcd.all_on, (bool)(data & 1));
       break;
 
     case 0b10100010 ... 0b10100011:
@@ -212,7 +440,7 @@ void LCD::write(LCD::State &lcd, uint8_t data, uint32_t address)
       break;
 
     case 0b11000000 ... 0b11001111:
-      lcd.reverse_com_scan = data & 8;
+      set_control(lcd, lcd.reverse_com_scan, (bool)(data & 8));
       break;
 
     case 0b10000001: // Set electric volume
@@ -230,6 +458,8 @@ void LCD::write(LCD::State &lcd, uint8_t data, uint32_t address)
   {
     if (lcd.page_address >= 8)
       data &= 1;
+    else if (lcd.gddram[lcd.page_address][lcd.column_address] != data)
+      lcd.page_changes[lcd.page_address]++;
 
     lcd.gddram[lcd.page_address][lcd.column_address] = data;
 
@@ -239,3 +469,34 @@ void LCD::write(LCD::State &lcd, uint8_t data, uint32_t address)
     }
   }
 }
+
+// Same as selecting the page and column 0, then writing length bytes of data
+void LCD::write_page_block(LCD::State &lcd, uint8_t page, const uint8_t *data, int length)
+{
+  const int columns = sizeof(lcd.gddram[0]);
+
+  // A pending contrast byte or the icon page need the write by write path
+  if (lcd.setting_volume || page >= 8 || length <= 0 || length > columns)
+  {
+    write(lcd, 0b10110000 | page, 0x20FE);
+    write(lcd, 0b00000000, 0x20FE);
+    write(lcd, 0b00010000, 0x20FE);
+
+    for (int i = 0; i < length; i++)
+    {
+      write(lcd, data[i], 0x20FF);
+    }
+
+    return;
+  }
+
+  if (memcmp(lcd.gddram[page], data, length))
+  {
+    memcpy(lcd.gddram[page], data, length);
+    lcd.page_changes[page]++;
+  }
+
+  lcd.page_address = page;
+  lcd.column_address = (length < 0x83) ? length : 0x83;
+  lcd.read_buffer = data[length - 1];
+}
@@ -17,6 +17,7 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
 #include <stdint.h>
+#include <string.h>
 
 #include "machine.h"
 #include "debug.h"
@@ -45,10 +46,13 @@ extern "C" void cpu_reset(Machine::State &cpu)
   Input::reset(cpu.input);
   GPIO::reset(cpu.gpio);
   Audio::reset(cpu.audio);
+  Profile::reset(cpu);
+  Debugger::reset(cpu);
+  Rewind::reset(cpu);
 
   // Load our reset vector
   cpu.reg.pc = cpu_read16(cpu, 2 * (int)IRQ::IRQ_RESET, TRACE_VECTOR);
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 
   cpu_writeSC(cpu, 0xC0);
   cpu.reg.ep = 0xFF;
@@ -61,6 +65,7 @@ extern "C" void cpu_reset(Machine::State &cpu)
 
 extern "C" void update_inputs(Machine::State &cpu, uint16_t value)
 {
+  Rewind::input(cpu, value);
   Input::update(cpu, value);
 }
 
@@ -76,6 +81,23 @@ void cpu_clock(Machine::State &cpu, int cycles)
 
   cpu.osc1_overflow += osc3 * OSC1_SPEED;
 
+  cpu.stats.clock_calls++;
+  cpu.stats.cycles += cycles;
+
+  if (cpu.status == Machine::STATUS_HALTED)
+  {
+    cpu.stats.halted_cycles += cycles;
+  }
+  else if (cpu.status == Machine::STATUS_SLEEPING)
+  {
+    cpu.stats.sleeping_cycles += cycles;
+  }
+
+  if (cpu.profile.active && Profile::clock(cpu.profile, cycles))
+  {
+    Profile::sample(cpu);
+  }
+
   if (cpu.status <= Machine::STATUS_HALTED)
   {
     LCD::clock(cpu, osc3);
@@ -105,15 +127,26 @@ void cpu_clock(Machine::State &cpu, int cycles)
   cpu.clocks -= osc3;
 }
 
-extern "C" void cpu_step(Machine::State &cpu)
+extern "C" const Stats::Counters *get_stats(Machine::State &cpu)
 {
-  // We have an IRQ Scheduled
-  IRQ::manage(cpu);
+  return &cpu.stats;
+}
+
+void cpu_execute(Machine::State &cpu)
+{
+  cpu.rewind.position++;
 
   // CPU Core steps
   if (cpu.status == Machine::STATUS_NORMAL)
   {
-    cpu_clock(cpu, inst_advance(cpu));
+    int cycles;
+
+    {
+      Stats::Timer timer(cpu.stats, Stats::HOST_CPU);
+      cycles = inst_advance(cpu);
+    }
+
+    cpu_clock(cpu, cycles);
   }
   else
   {
@@ -122,17 +155,60 @@ extern "C" void cpu_step(Machine::State &cpu)
   }
 }
 
-extern "C" void cpu_advance(Machine::State &cpu, int ticks)
+static inline void cpu_checkpoint(Machine::State &cpu)
+{
+  if (cpu.rewind.recording && cpu.rewind.position >= cpu.rewind.next_keyframe)
+  {
+    Rewind::capture(cpu);
+  }
+}
+
+extern "C" void cpu_step(Machine::State &cpu)
+{
+  cpu_checkpoint(cpu);
+
+  // We have an IRQ Scheduled
+  IRQ::manage(cpu);
+  cpu_execute(cpu);
+
+  // Host steps ignore breakpoints, and continuing from here shouldn't stop either
+  Debugger::resume_at(cpu, calc_pc(cpu));
+}
+
+extern "C" Debugger::StopReason cpu_advance(Machine::State &cpu, int ticks)
 {
   cpu.clocks += ticks;
+  cpu.debugger.stop_reason = Debugger::STOP_NONE;
 
   while (cpu.clocks > 0)
   {
-    cpu_step(cpu);
+    if (cpu.recorder.enabled && Recorder::full(cpu.recorder))
+    {
+      return cpu.debugger.stop_reason = Debugger::STOP_RECORDER_FULL;
+    }
+
+    cpu_checkpoint(cpu);
+    IRQ::manage(cpu);
+
+    if (cpu.debugger.armed && cpu.status == Machine::STATUS_NORMAL && Debugger::break_at(cpu, calc_pc(cpu)))
+    {
+      return cpu.debugger.stop_reason;
+    }
+
+    cpu_execute(cpu);
+
+    // Data watchpoint hit during the instruction
+    if (cpu.debugger.stop_reason != Debugger::STOP_NONE)
+    {
+      return cpu.debugger.stop_reason;
+    }
   }
+
+  return Debugger::STOP_NONE;
 }
 
-static inline uint8_t cpu_read_reg(Machine::State &cpu, uint32_t address)
+// Peeks take the side-effect free path of every register
+static inline uint8_t cpu_read_reg(Machine::State &cpu, uint32_t address, bool peek = false)
 {
   switch (address)
   {
@@ -156,7 +232,7 @@ static inline uint8_t cpu_read_reg(Machine::State &cpu, uint32_t address)
   case 0x20FE ... 0x20FF:
     if (Control::is_lcd_enabled(cpu.ctrl))
     {
-      return LCD::read(cpu.lcd, address);
+      return peek ? LCD::peek(cpu.lcd, address) : LCD::read(cpu.lcd, address);
     }
     else
     {
@@ -171,7 +247,10 @@ static inline uint8_t cpu_read_reg(Machine::State &cpu, uint32_t address)
   case 0x2048 ... 0x204F:
     return Timers::read(cpu, address);
   default:
-    dprintf("Unhandled register read %x", address);
+    if (!peek)
+    {
+      dprintf("Unhandled register read %x", address);
+    }
     return cpu.bus_cap;
   }
 }
@@ -261,6 +340,7 @@ extern "C" void cpu_write(Machine::State &cpu, uint8_t data, uint32_t address)
   if (address >= 0x1000 && address <= 0x1FFF)
   {
     cpu.ram[address & 0xFFF] = data;
+    cpu.ram_generation[(address >> 8) & 0xF]++;
   }
   else if (address >= 0x2000 && address <= 0x20FF)
   {
@@ -272,6 +352,102 @@ extern "C" void cpu_write(Machine::State &cpu, uint8_t data, uint32_t address)
   }
 }
 
+/**
+ * Host memory access, nothing here changes emulation state
+ **/
+
+uint8_t cpu_peek(Machine::State &cpu, uint32_t address)
+{
+  if (address <= 0x0FFF)
+  {
+    return cpu.buffers.bios[address];
+  }
+  else if (address <= 0x1FFF)
+  {
+    return cpu.ram[address & 0xFFF];
+  }
+  else if (address <= 0x20FF)
+  {
+    return cpu_read_reg(cpu, address, true);
+  }
+  else if (Control::is_cart_enabled(cpu.ctrl))
+  {
+    return cpu_read_cart(cpu, address);
+  }
+  else
+  {
+    return cpu.bus_cap;
+  }
+}
+
+extern "C" void peek_block(Machine::State &cpu, uint32_t address, uint32_t length, uint8_t *out)
+{
+  while (length > 0)
+  {
+    uint32_t count = 1;
+
+    // Memory is copied a region at a time, registers and the open bus a byte at a time
+    if (address <= 0x0FFF)
+    {
+      count = 0x1000 - address;
+      memcpy(out, &cpu.buffers.bios[address], count < length ? count : length);
+    }
+    else if (address <= 0x1FFF)
+    {
+      count = 0x2000 - address;
+      memcpy(out, &cpu.ram[address & 0xFFF], count < length ? count : length);
+    }
+    else if (address >= 0x2100 && Control::is_cart_enabled(cpu.ctrl))
+    {
+      uint32_t offset = address % sizeof(cpu.buffers.cartridge);
+      count = sizeof(cpu.buffers.cartridge) - offset;
+      memcpy(out, &cpu.buffers.cartridge[offset], count < length ? count : length);
+    }
+    else
+    {
+      *out = cpu_peek(cpu, address);
+    }
+
+    if (count > length)
+    {
+      count = length;
+    }
+
+    address += count;
+    out += count;
+    length -= count;
+  }
+}
+
+// The host rewrote the cartridge buffer directly
+extern "C" void cartridge_changed(Machine::State &cpu)
+{
+  cpu.rom_generation++;
+}
+
+// Registers are skipped, writing one is a side effect by definition
+extern "C" void poke_block(Machine::State &cpu, uint32_t address, uint32_t length, const uint8_t *in)
+{
+  for (; length > 0; address++, in++, length--)
+  {
+    if (address <= 0x0FFF)
+    {
+      cpu.buffers.bios[address] = *in;
+      cpu.rom_generation++;
+    }
+    else if (address <= 0x1FFF)
+    {
+      cpu.ram[address & 0xFFF] = *in;
+      cpu.ram_generation[(address >> 8) & 0xF]++;
+    }
+    else if (address >= 0x2100)
+    {
+      cpu.buffers.cartridge[address % sizeof(cpu.buffers.cartridge)] = *in;
+      cpu.rom_generation++;
+    }
+  }
+}
+
 /**
  * S1C88 Memory access helper functions
  **/
@@ -283,13 +459,25 @@ static TraceType operator|(TraceType A, TraceType B)
 uint8_t cpu_read8(Machine::State &cpu, uint32_t address, TraceType access)
 {
   cpu.bus_cap = cpu_read(cpu, address);
-  trace_access(cpu, address, access | TRACE_READ);
+  cpu_trace(cpu, address, access | TRACE_READ);
+
+  if (cpu.debugger.watching)
+  {
+    Debugger::watch(cpu, address, access | TRACE_READ, cpu.bus_cap);
+  }
+
   return cpu.bus_cap;
 }
 
 void cpu_write8(Machine::State &cpu, uint8_t data, uint32_t address, TraceType access)
 {
-  trace_access(cpu, address, access | TRACE_WRITE);
+  cpu_trace(cpu, address, access | TRACE_WRITE);
+
+  if (cpu.debugger.watching)
+  {
+    Debugger::watch(cpu, address, access | TRACE_WRITE, data);
+  }
+
   cpu_write(cpu, cpu.bus_cap = data, address);
 }
 
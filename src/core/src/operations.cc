@@ -563,7 +563,7 @@ static inline void op_jrs8(Machine::State &cpu, uint8_t t)
   cpu.reg.cb = cpu.reg.nb;
   cpu.reg.pc += (int8_t)t - 1;
 
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 static inline void op_jrl16(Machine::State &cpu, uint16_t t)
@@ -571,7 +571,7 @@ static inline void op_jrl16(Machine::State &cpu, uint16_t t)
   cpu.reg.cb = cpu.reg.nb;
   cpu.reg.pc += t - 1;
 
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 static inline void inst_djr_nz_rr(Machine::State &cpu)
@@ -584,7 +584,7 @@ static inline void inst_djr_nz_rr(Machine::State &cpu)
     cpu.reg.cb = cpu.reg.nb;
     cpu.reg.pc += off - 1;
 
-    trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+    cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
   }
 }
 
@@ -593,44 +593,55 @@ static inline void op_jp16(Machine::State &cpu, uint16_t t)
   cpu.reg.pc = t;
   cpu.reg.cb = cpu.reg.nb;
 
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 static inline void op_cars8(Machine::State &cpu, uint8_t t)
 {
+  uint32_t site = calc_pc(cpu);
+
   cpu_push8(cpu, cpu.reg.cb);
   cpu_push16(cpu, cpu.reg.pc, TRACE_RETURN_ADDRESS);
 
   cpu.reg.pc += (int8_t)t - 1;
   cpu.reg.cb = cpu.reg.nb;
 
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  profile_enter(cpu, site);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 static inline void op_carl16(Machine::State &cpu, uint16_t t)
 {
+  uint32_t site = calc_pc(cpu);
+
   cpu_push8(cpu, cpu.reg.cb);
   cpu_push16(cpu, cpu.reg.pc, TRACE_RETURN_ADDRESS);
 
   cpu.reg.pc += t - 1;
   cpu.reg.cb = cpu.reg.nb;
 
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  profile_enter(cpu, site);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 static inline void op_call16(Machine::State &cpu, uint16_t t)
 {
+  uint32_t site = calc_pc(cpu);
+
   cpu_push8(cpu, cpu.reg.cb);
   cpu_push16(cpu, cpu.reg.pc, TRACE_RETURN_ADDRESS);
 
   cpu.reg.pc = t;
   cpu.reg.cb = cpu.reg.nb;
 
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  profile_enter(cpu, site);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 static inline void op_int16(Machine::State &cpu, uint16_t t)
 {
+  uint32_t site = calc_pc(cpu);
+
   cpu_push8(cpu, cpu.reg.cb);
   cpu_push16(cpu, cpu.reg.pc, TRACE_RETURN_ADDRESS);
   cpu_push8(cpu, cpu_readSC(cpu));
@@ -638,17 +649,22 @@ static inline void op_int16(Machine::State &cpu, uint16_t t)
   cpu.reg.pc = t;
   cpu.reg.cb = cpu.reg.nb;
 
-  trace_access(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
+  profile_enter(cpu, site);
+  cpu_trace(cpu, calc_pc(cpu), TRACE_BRANCH_TARGET);
 }
 
 static inline void inst_ret(Machine::State &cpu)
 {
+  profile_leave(cpu);
+
   cpu.reg.pc = cpu_pop16(cpu);
   cpu.reg.nb = cpu.reg.cb = cpu_pop8(cpu);
 }
 
 static inline void op_rete8(Machine::State &cpu)
 {
+  profile_leave(cpu);
+
   cpu_writeSC(cpu, cpu_pop8(cpu));
   cpu.reg.pc = cpu_pop16(cpu);
   cpu.reg.nb = cpu.reg.cb = cpu_pop8(cpu);
@@ -656,6 +672,8 @@ static inline void op_rete8(Machine::State &cpu)
 
 static inline void inst_rets(Machine::State &cpu)
 {
+  profile_leave(cpu);
+
   cpu.reg.pc = cpu_pop16(cpu);
   cpu.reg.nb = cpu.reg.cb = cpu_pop8(cpu);
   cpu.reg.pc += 2;
@@ -686,5 +704,51 @@ static int inst_undefined(Machine::State &cpu)
   return 0;
 }
 
+/**
+ * Instruction entry
+ *
+ * Runs ahead of every instruction: the recorder, the instruction count and,
+ * in PROFILE_OPCODES builds, per opcode executions and cycles
+ **/
+
+// The instruction recorder sees every instruction, replays are history it already has
+static inline void record_enter(Machine::State &cpu)
+{
+  if (cpu.recorder.enabled && !cpu.rewind.replaying)
+  {
+    Recorder::record(cpu);
+  }
+}
+
+#ifdef PROFILE_OPCODES
+static inline void instruction_enter(Machine::State &cpu)
+{
+  record_enter(cpu);
+  cpu.stats.instructions++;
+  cpu.opcodes.chained_cycles = 0;
+}
+
+static inline int profile_opcode(Machine::State &cpu, int index, int cycles)
+{
+  // Instructions that block IRQs return the cycles of the next instruction as well
+  cpu.opcodes.executions[index]++;
+  cpu.opcodes.cycles[index] += cycles - cpu.opcodes.chained_cycles;
+  cpu.opcodes.chained_cycles = cycles;
+
+  return cycles;
+}
+#else
+static inline void instruction_enter(Machine::State &cpu)
+{
+  record_enter(cpu);
+  cpu.stats.instructions++;
+}
+
+static inline int profile_opcode(Machine::State &cpu, int index, int cycles)
+{
+  return cycles;
+}
+#endif
+
 // Generated compound instructions and tables
 #include "table.h"
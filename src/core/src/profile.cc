@@ -0,0 +1,157 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+
+void Profile::reset(Machine::State &cpu)
+{
+  cpu.profile.depth = 0;
+}
+
+/**
+ * Call graph edges
+ **/
+
+int16_t Profile::find_edge(Profile::State &profile, uint32_t site, uint32_t target)
+{
+  uint32_t hash = site * 0x9E3779B1 + target * 0x85EBCA6B;
+
+  // The slot table is never more than half full, so probing always terminates
+  for (uint32_t slot = hash ^ (hash >> 16);; slot++)
+  {
+    int16_t &index = profile.edge_slots[slot & (Profile::EDGE_SLOTS - 1)];
+
+    if (index < 0)
+    {
+      if (profile.edge_count >= Profile::EDGE_COUNT)
+      {
+        profile.edges_dropped++;
+        return -1;
+      }
+
+      Profile::Edge &edge = profile.edges[index = profile.edge_count++];
+      edge.site = site;
+      edge.target = target;
+
+      return index;
+    }
+
+    const Profile::Edge &edge = profile.edges[index];
+
+    if (edge.site == site && edge.target == target)
+    {
+      return index;
+    }
+  }
+}
+
+/**
+ * Shadow call stack
+ **/
+
+// Drop the outermost frame, its time goes unrecorded
+void Profile::drop_outermost(Profile::State &profile)
+{
+  for (int i = 1; i < STACK_DEPTH; i++)
+  {
+    profile.stack[i - 1] = profile.stack[i];
+  }
+
+  profile.depth = STACK_DEPTH - 1;
+}
+
+/**
+ * Cycle accounting and statistical sampler
+ **/
+
+void Profile::sample(Machine::State &cpu)
+{
+  Profile::State &profile = cpu.profile;
+
+  profile.countdown += profile.interval;
+
+  Sample &sample = profile.samples[profile.write_index++ % SAMPLE_COUNT];
+  uint32_t frames = profile.depth < SAMPLE_DEPTH ? profile.depth : SAMPLE_DEPTH;
+  const Frame *frame = &profile.stack[profile.depth - frames];
+
+  sample.pc = calc_pc(cpu);
+  sample.depth = profile.depth;
+
+  for (uint32_t i = 0; i < frames; i++)
+  {
+    sample.frames[i] = (frame++)->target;
+  }
+}
+
+// Both profilers share the shadow stack, it only starts over when neither
+// was keeping it up to date
+static void set_active(Profile::State &profile)
+{
+  bool active = profile.sampling || profile.callgraph;
+
+  if (active && !profile.active)
+  {
+    profile.depth = 0;
+  }
+
+  profile.active = active;
+}
+
+extern "C" void set_sampling(Machine::State &cpu, int interval)
+{
+  Profile::State &profile = cpu.profile;
+
+  profile.sampling = interval > 0;
+  profile.interval = interval;
+  profile.countdown = interval;
+  profile.write_index = 0;
+
+  set_active(profile);
+}
+
+extern "C" void set_callgraph(Machine::State &cpu, bool enabled)
+{
+  Profile::State &profile = cpu.profile;
+
+  profile.callgraph = enabled;
+
+  // Turning it off only stops collection, the table stays readable
+  if (enabled)
+  {
+    profile.cycles = 0;
+    profile.edge_count = 0;
+    profile.edges_dropped = 0;
+
+    memset(profile.edge_slots, 0xFF, sizeof(profile.edge_slots));
+    memset(profile.edges, 0, sizeof(profile.edges));
+  }
+
+  // Frames still open have no edge to close, the table either started after
+  // them or is already closed
+  for (uint32_t i = 0; i < profile.depth; i++)
+  {
+    profile.stack[i].edge = -1;
+    profile.stack[i].start = 0;
+    profile.stack[i].nested = 0;
+  }
+
+  set_active(profile);
+}
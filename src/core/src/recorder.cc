@@ -0,0 +1,84 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+
+void Recorder::record(Machine::State &cpu)
+{
+  Recorder::State &recorder = cpu.recorder;
+
+  if (pending(recorder) >= RING_SIZE)
+  {
+    recorder.dropped++;
+    return;
+  }
+
+  Entry &entry = recorder.ring[recorder.head & (RING_SIZE - 1)];
+  uint32_t address = calc_pc(cpu);
+
+  entry.cycle = cpu.stats.cycles;
+  entry.address = address;
+
+  // Code almost always runs from the cartridge or BIOS, anything else takes the slow path
+  if (address >= 0x2100 && address + 4 <= sizeof(cpu.buffers.cartridge) && Control::is_cart_enabled(cpu.ctrl))
+  {
+    memcpy(entry.bytes, &cpu.buffers.cartridge[address], sizeof(entry.bytes));
+  }
+  else if (address + 4 <= 0x1000)
+  {
+    memcpy(entry.bytes, &cpu.buffers.bios[address], sizeof(entry.bytes));
+  }
+  else
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      entry.bytes[i] = Debugger::peek8(cpu, address + i);
+    }
+  }
+
+  entry.pc = cpu.reg.pc;
+  entry.ba = cpu.reg.ba;
+  entry.hl = cpu.reg.hl;
+  entry.ix = cpu.reg.ix;
+  entry.iy = cpu.reg.iy;
+  entry.sp = cpu.reg.sp;
+  entry.br = cpu.reg.br;
+  entry.ep = cpu.reg.ep;
+  entry.xp = cpu.reg.xp;
+  entry.yp = cpu.reg.yp;
+  entry.nb = cpu.reg.nb;
+  entry.cb = cpu.reg.cb;
+  entry.sc = cpu_readSC(cpu);
+  entry.reserved = 0;
+
+  // Publish the entry only once it is complete
+  __atomic_store_n(&recorder.head, recorder.head + 1, __ATOMIC_RELEASE);
+}
+
+extern "C" void recorder_enable(Machine::State &cpu, bool enabled)
+{
+  Recorder::State &recorder = cpu.recorder;
+
+  recorder.enabled = enabled;
+  recorder.head = 0;
+  recorder.tail = 0;
+  recorder.dropped = 0;
+}
@@ -0,0 +1,380 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+
+/**
+ * Keyframes
+ *
+ * Execution is deterministic given the machine state and the host input
+ * changes, so history is kept as a ring of periodic snapshots plus a log
+ * of inputs. Any earlier step is reached by restoring the closest keyframe
+ * and re-executing forward.
+ **/
+
+void Rewind::reset(Machine::State &cpu)
+{
+  Rewind::State &rewind = cpu.rewind;
+
+  rewind.keyframe_index = 0;
+  rewind.input_index = 0;
+  rewind.next_keyframe = rewind.position;
+}
+
+static void save(Machine::State &cpu, Rewind::Snapshot &snapshot)
+{
+  snapshot.position = cpu.rewind.position;
+  snapshot.reg = cpu.reg;
+  snapshot.irq = cpu.irq;
+  snapshot.lcd = cpu.lcd;
+  snapshot.rtc = cpu.rtc;
+  snapshot.ctrl = cpu.ctrl;
+  snapshot.tim256 = cpu.tim256;
+  snapshot.blitter = cpu.blitter;
+  snapshot.timers = cpu.timers;
+  snapshot.input = cpu.input;
+  snapshot.gpio = cpu.gpio;
+  snapshot.audio = cpu.audio;
+  snapshot.bus_cap = cpu.bus_cap;
+  snapshot.osc1_overflow = cpu.osc1_overflow;
+  snapshot.status = cpu.status;
+
+  memcpy(snapshot.ram, cpu.ram, sizeof(snapshot.ram));
+  snapshot.lcd_history = cpu.buffers.lcd_history;
+
+  for (int i = 0; i < Debugger::CONDITION_COUNT; i++)
+  {
+    snapshot.condition_hits[i] = cpu.debugger.conditions[i].hits;
+  }
+}
+
+static void load(Machine::State &cpu, const Rewind::Snapshot &snapshot)
+{
+  cpu.rewind.position = snapshot.position;
+  cpu.reg = snapshot.reg;
+  cpu.irq = snapshot.irq;
+  cpu.lcd = snapshot.lcd;
+  cpu.rtc = snapshot.rtc;
+  cpu.ctrl = snapshot.ctrl;
+  cpu.tim256 = snapshot.tim256;
+  cpu.blitter = snapshot.blitter;
+  cpu.timers = snapshot.timers;
+  cpu.input = snapshot.input;
+  cpu.gpio = snapshot.gpio;
+  cpu.audio = snapshot.audio;
+  cpu.bus_cap = snapshot.bus_cap;
+  cpu.osc1_overflow = snapshot.osc1_overflow;
+  cpu.status = (Machine::Status)snapshot.status;
+
+  memcpy(cpu.ram, snapshot.ram, sizeof(snapshot.ram));
+
+  for (auto &generation : cpu.ram_generation)
+  {
+    generation++;
+  }
+
+  cpu.buffers.lcd_history = snapshot.lcd_history;
+
+  for (int i = 0; i < Debugger::CONDITION_COUNT; i++)
+  {
+    cpu.debugger.conditions[i].hits = snapshot.condition_hits[i];
+  }
+}
+
+void Rewind::capture(Machine::State &cpu)
+{
+  Rewind::State &rewind = cpu.rewind;
+
+  if (rewind.replaying)
+  {
+    return;
+  }
+
+  save(cpu, rewind.keyframes[rewind.keyframe_index++ % KEYFRAME_COUNT]);
+  rewind.next_keyframe = rewind.position + rewind.interval;
+}
+
+void Rewind::input(Machine::State &cpu, uint16_t value)
+{
+  Rewind::State &rewind = cpu.rewind;
+
+  if (!rewind.recording || rewind.replaying)
+  {
+    return;
+  }
+
+  InputEvent &event = rewind.inputs[rewind.input_index++ % INPUT_COUNT];
+  event.position = rewind.position;
+  event.value = value;
+}
+
+static uint32_t keyframes_held(const Rewind::State &rewind)
+{
+  return rewind.keyframe_index < Rewind::KEYFRAME_COUNT ? rewind.keyframe_index : Rewind::KEYFRAME_COUNT;
+}
+
+// Age 0 is the newest keyframe
+static const Rewind::Snapshot &keyframe(const Rewind::State &rewind, uint32_t age)
+{
+  return rewind.keyframes[(rewind.keyframe_index - 1 - age) % Rewind::KEYFRAME_COUNT];
+}
+
+/**
+ * Re-execution
+ **/
+
+enum Search
+{
+  SEARCH_NONE,
+  SEARCH_FRAME, // Steps at or above a stack pointer, for reverse step over
+  SEARCH_STOP   // Steps where forward execution would have stopped
+};
+
+struct Replay
+{
+  Search search;
+  uint16_t sp;
+
+  // Last match, found is false until one is seen
+  bool found;
+  uint64_t position;
+  Debugger::StopReason stop_reason;
+  uint32_t stop_address;
+  int32_t stop_watchpoint;
+  int32_t stop_condition;
+  uint8_t stop_kind;
+  uint32_t stop_access;
+  uint8_t stop_value;
+};
+
+static void remember(Machine::State &cpu, Replay &replay, uint64_t position)
+{
+  const Debugger::State &debugger = cpu.debugger;
+
+  replay.found = true;
+  replay.position = position;
+  replay.stop_reason = debugger.stop_reason;
+  replay.stop_address = debugger.stop_address;
+  replay.stop_watchpoint = debugger.stop_watchpoint;
+  replay.stop_condition = debugger.stop_condition;
+  replay.stop_kind = debugger.stop_kind;
+  replay.stop_access = debugger.stop_access;
+  replay.stop_value = debugger.stop_value;
+}
+
+// Restores the given keyframe and executes up to (but not including) step target
+static void run(Machine::State &cpu, const Rewind::Snapshot &snapshot, uint64_t target, Replay &replay)
+{
+  Rewind::State &rewind = cpu.rewind;
+  Debugger::State &debugger = cpu.debugger;
+
+  load(cpu, snapshot);
+
+  // First input event at or after the keyframe, logged inputs are idempotent
+  uint32_t oldest = rewind.input_index > Rewind::INPUT_COUNT ? rewind.input_index - Rewind::INPUT_COUNT : 0;
+  uint32_t next_input = rewind.input_index;
+
+  while (next_input > oldest && rewind.inputs[(next_input - 1) % Rewind::INPUT_COUNT].position >= rewind.position)
+  {
+    next_input--;
+  }
+
+  while (rewind.position < target)
+  {
+    while (next_input < rewind.input_index && rewind.inputs[next_input % Rewind::INPUT_COUNT].position <= rewind.position)
+    {
+      Input::update(cpu, rewind.inputs[next_input++ % Rewind::INPUT_COUNT].value);
+    }
+
+    IRQ::manage(cpu);
+
+    uint64_t position = rewind.position;
+
+    switch (replay.search)
+    {
+    case SEARCH_NONE:
+      break;
+    case SEARCH_FRAME:
+      if (cpu.status == Machine::STATUS_NORMAL && cpu.reg.sp >= replay.sp)
+      {
+        replay.found = true;
+        replay.position = position;
+      }
+      break;
+    case SEARCH_STOP:
+      debugger.skip = false;
+      debugger.stop_reason = Debugger::STOP_NONE;
+
+      if (debugger.armed && cpu.status == Machine::STATUS_NORMAL && Debugger::break_at(cpu, calc_pc(cpu)))
+      {
+        remember(cpu, replay, position);
+      }
+
+      debugger.stop_reason = Debugger::STOP_NONE;
+      break;
+    }
+
+    cpu_execute(cpu);
+
+    // Data watchpoints stop once the instruction is done
+    if (replay.search == SEARCH_STOP && debugger.stop_reason != Debugger::STOP_NONE)
+    {
+      if (rewind.position < target)
+      {
+        remember(cpu, replay, rewind.position);
+      }
+
+      debugger.stop_reason = Debugger::STOP_NONE;
+    }
+  }
+}
+
+// History after the step we moved back to no longer happens
+static void forget_after(Rewind::State &rewind, uint64_t position)
+{
+  while (keyframes_held(rewind) && keyframe(rewind, 0).position > position)
+  {
+    rewind.keyframe_index--;
+  }
+
+  while (rewind.input_index && rewind.inputs[(rewind.input_index - 1) % Rewind::INPUT_COUNT].position >= position)
+  {
+    rewind.input_index--;
+  }
+
+  rewind.next_keyframe = keyframe(rewind, 0).position + rewind.interval;
+}
+
+// Searches backwards from the current step one keyframe segment at a time,
+// and leaves the machine at the latest match (or where it was)
+static bool search(Machine::State &cpu, Replay &replay)
+{
+  Rewind::State &rewind = cpu.rewind;
+  Profile::State &profile = cpu.profile;
+
+  uint64_t current = rewind.position;
+  uint32_t held = keyframes_held(rewind);
+  uint32_t age = 0;
+  bool active = profile.active;
+
+  if (!rewind.recording || !held)
+  {
+    return false;
+  }
+
+  // Keep profilers and logpoints out of re-executed history
+  rewind.replaying = true;
+  profile.active = false;
+
+  // Skip keyframes captured at or after the current step
+  while (age < held && keyframe(rewind, age).position >= current)
+  {
+    age++;
+  }
+
+  for (uint64_t end = current; age < held; end = keyframe(rewind, age++).position)
+  {
+    replay.found = false;
+    run(cpu, keyframe(rewind, age), end, replay);
+
+    if (replay.found)
+    {
+      break;
+    }
+  }
+
+  // Land on the match, or go back to where we started
+  Replay seek = {SEARCH_NONE};
+  uint64_t target = replay.found ? replay.position : current;
+  age = 0;
+
+  while (age < held - 1 && keyframe(rewind, age).position > target)
+  {
+    age++;
+  }
+
+  run(cpu, keyframe(rewind, age), target, seek);
+  forget_after(rewind, target);
+
+  rewind.replaying = false;
+  profile.active = active;
+  cpu.clocks = 0;
+  cpu.debugger.stop_reason = Debugger::STOP_NONE;
+
+  // Continuing forward from here shouldn't stop on the same spot
+  Debugger::resume_at(cpu, calc_pc(cpu));
+
+  return replay.found;
+}
+
+extern "C" void rewind_enable(Machine::State &cpu, uint32_t interval)
+{
+  Rewind::State &rewind = cpu.rewind;
+
+  rewind.recording = interval > 0;
+  rewind.interval = interval;
+  Rewind::reset(cpu);
+}
+
+extern "C" bool cpu_step_back(Machine::State &cpu)
+{
+  Replay replay = {SEARCH_NONE};
+
+  if (cpu.rewind.position == 0)
+  {
+    return false;
+  }
+
+  // Any earlier instruction matches
+  replay.search = SEARCH_FRAME;
+  replay.sp = 0;
+
+  return search(cpu, replay);
+}
+
+extern "C" bool cpu_reverse_step_over(Machine::State &cpu)
+{
+  Replay replay = {SEARCH_FRAME};
+  replay.sp = cpu.reg.sp;
+
+  return search(cpu, replay);
+}
+
+extern "C" Debugger::StopReason cpu_reverse_continue(Machine::State &cpu)
+{
+  Replay replay = {SEARCH_STOP};
+  Debugger::State &debugger = cpu.debugger;
+
+  if (!search(cpu, replay))
+  {
+    return Debugger::STOP_NONE;
+  }
+
+  debugger.stop_reason = replay.stop_reason;
+  debugger.stop_address = replay.stop_address;
+  debugger.stop_watchpoint = replay.stop_watchpoint;
+  debugger.stop_condition = replay.stop_condition;
+  debugger.stop_kind = replay.stop_kind;
+  debugger.stop_access = replay.stop_access;
+  debugger.stop_value = replay.stop_value;
+
+  return replay.stop_reason;
+}
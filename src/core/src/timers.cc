@@ -124,6 +124,8 @@ static inline void process_timer(Machine::State& cpu, int osc1, int osc3, Timer&
 }
 
 void Timers::clock(Machine::State& cpu, int osc1, int osc3) {
+	Stats::Timer timer(cpu.stats, Stats::HOST_TIMERS);
+
 	if (!cpu.timers.osc1_enable) osc1 = 0;
 	if (!cpu.timers.osc3_enable) osc3 = 0;
 
@@ -0,0 +1,68 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+
+/**
+ * Host interface to the access trace kept for the debugger
+ **/
+
+extern "C" void trace_enable(Machine::State &cpu, bool enabled)
+{
+  cpu.trace.enabled = enabled;
+}
+
+// Forget everything outside the BIOS, which never changes
+extern "C" void trace_reset(Machine::State &cpu)
+{
+  Trace::State &trace = cpu.trace;
+
+  memset(&trace.attributes[0x1000], 0, sizeof(trace.attributes) - 0x1000);
+
+  trace.generation++;
+  for (int bank = 0; bank < Trace::BANK_COUNT; bank++)
+  {
+    trace.bank_generation[bank] = trace.generation;
+  }
+}
+
+// The debugger overrides what a byte is shown as
+extern "C" void trace_set(Machine::State &cpu, uint32_t address, uint8_t attributes)
+{
+  Trace::set(cpu.trace, address & (Trace::ADDRESS_SPACE - 1), attributes);
+}
+
+// Bit n is set when bank n changed after generation since
+extern "C" uint64_t trace_changed_banks(Machine::State &cpu, uint32_t since)
+{
+  const Trace::State &trace = cpu.trace;
+  uint64_t changed = 0;
+
+  for (int bank = 0; bank < Trace::BANK_COUNT; bank++)
+  {
+    if (trace.bank_generation[bank] > since)
+    {
+      changed |= 1ull << bank;
+    }
+  }
+
+  return changed;
+}
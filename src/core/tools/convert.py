@@ -98,14 +98,14 @@ def format(op, arg1, arg2):
     if arg1 in CONDITIONS:
         condition, arg1, arg2 = CONDITIONS[arg1], arg2, None
 
-    args = ["Argument.%s" % ARGUMENTS[arg] for arg in [arg1, arg2] if arg]
+    args = [ARGUMENTS[arg] for arg in [arg1, arg2] if arg]
 
     # add conditions
     return { "op": op, "condition": condition or "NONE", "args": args }
 
 def display(table, tabs = ""):
     if type(table) == dict:
-        return '%s{ "op": "%s", "condition": Condition.%s, "args": [ %s ] }' % ( tabs, table['op'], table['condition'], ", ".join(table["args"]))
+        return '%s{ "op": "%s", "condition": Condition.%s, "args": [ %s ] }' % ( tabs, table['op'], table['condition'], ", ".join(["Argument.%s" % arg for arg in table["args"]]))
         return "%sggg" % tabs
     elif type(table) == list:
         return "%s[\n%s\n%s]" % (tabs, (",\n").join([ display(t, tabs + "\t") for t in table ]), tabs)
@@ -134,12 +134,21 @@ with open(os.path.join(os.path.dirname(__file__), 's1c88.csv'), 'r') as csvfile:
         all_ops += [op0, op1, op2]
         all_args += [arg0_1, arg0_2, arg1_1, arg1_2, arg2_1, arg2_2]
 
-print ("""export enum Argument {
+# Mnemonics in order of first appearance, shared with the disassembler in the core
+OPERATIONS = ["NDEF"]
+for op in all_ops:
+    if op not in OPERATIONS + ['[EXPANSION]', 'undefined']:
+        OPERATIONS.append(op)
+
+if __name__ == "__main__":
+    print ("""export enum Argument {
     %s 
 };""" % ',\n\t'.join(ARGUMENTS.values()))
 
-print ("""export enum Condition {
+    print ("""export enum Condition {
     %s 
 };""" % ',\n\t'.join(CONDITIONS.values()))
 
-print ("export const InstructionTable = %s;" % display(op0s))
+    print ("export const Operations = [ %s ];" % ", ".join(['"%s"' % op for op in OPERATIONS]))
+
+    print ("export const InstructionTable = %s;" % display(op0s))
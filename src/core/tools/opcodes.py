@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+
+# ISC License
+# 
+# Copyright (c) 2019, Bryon Vandiver
+# 
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Decoding tables for the disassembler, numbered to match instructions.ts
+
+from convert import ARGUMENTS, CONDITIONS, OPERATIONS, op0s, op1s, op2s
+
+def enum(name, prefix, values, extra = ""):
+    print ("\tenum %s : uint8_t {" % name)
+    for i, value in enumerate(values):
+        print ("\t\t%s_%s = %i," % (prefix, value, i))
+    if extra:
+        print ("\t\t%s" % extra)
+    print ("\t};\n")
+
+def entry(op):
+    if type(op) != dict:
+        return "{ OPERATION_NDEF, CONDITION_NONE, { ARGUMENT_NONE, ARGUMENT_NONE } }"
+
+    args = ["ARGUMENT_%s" % arg for arg in op["args"]] + ["ARGUMENT_NONE"] * 2
+    return "{ OPERATION_%s, CONDITION_%s, { %s } }" % (op["op"], op["condition"], ", ".join(args[:2]))
+
+print ("#pragma once\n")
+print ("#include <stdint.h>\n")
+print ("namespace Disassembler {")
+enum("Operation", "OPERATION", OPERATIONS)
+enum("Argument", "ARGUMENT", ARGUMENTS.values(), "ARGUMENT_NONE = 0xFF,")
+enum("Condition", "CONDITION", CONDITIONS.values())
+
+print ("\tstruct Opcode {")
+print ("\t\tOperation operation;")
+print ("\t\tCondition condition;")
+print ("\t\tArgument arguments[2];")
+print ("\t};\n")
+
+print ("\t// 0x000~0x0FF: base, 0x100~0x1FF: CE prefix, 0x200~0x2FF: CF prefix")
+print ("\tstatic const Opcode OPCODES[0x300] = {")
+for table in [op0s, op1s, op2s]:
+    for op in table:
+        print ("\t\t%s," % entry(op))
+print ("\t};")
+print ("};")
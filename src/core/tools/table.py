@@ -221,13 +221,13 @@ def format(cycles, op, *args):
         return "clock_%s" % name
 
 # Generate switch table
-def dump_table(instructions, indent):
+def dump_table(instructions, indent, table):
     for i, t in enumerate(instructions):
         if not t:
             continue
-        print ("%scase 0x%02X: return %s(cpu);" % (indent, i, t))
+        print ("%scase 0x%02X: return profile_opcode(cpu, 0x%03X, %s(cpu));" % (indent, i, table * 0x100 + i, t))
         #print (i, t)
-    print ("%sdefault: return inst_undefined(cpu);" % indent)
+    print ("%sdefault: return profile_opcode(cpu, 0x%03X | op, inst_undefined(cpu));" % (indent, table * 0x100))
 
 with open(CSV_LOCATION, 'r') as csvfile:
     spamreader = csv.reader(csvfile)
@@ -246,15 +246,17 @@ with open(CSV_LOCATION, 'r') as csvfile:
         	op2s[code] = format(cycles2, op2, arg2_1, arg2_2)
 
 print ("int inst_advance(Machine::State& cpu) {")
-print ("\tswitch (cpu_imm8(cpu, TRACE_INSTRUCTION)) {")
-dump_table(op0s, '\t')
+print ("\tuint8_t op;")
+print ("\tinstruction_enter(cpu);")
+print ("\tswitch (op = cpu_imm8(cpu, TRACE_INSTRUCTION)) {")
+dump_table(op0s, '\t', 0)
 print ("\tcase 0xCE:")
-print ("\t\tswitch (cpu_imm8(cpu, TRACE_EX_INST)) {")
-dump_table(op1s, '\t\t')
+print ("\t\tswitch (op = cpu_imm8(cpu, TRACE_EX_INST)) {")
+dump_table(op1s, '\t\t', 1)
 print ("\t\t}")
 print ("\tcase 0xCF:")
-print ("\t\tswitch (cpu_imm8(cpu, TRACE_EX_INST)) {")
-dump_table(op2s, '\t\t')
+print ("\t\tswitch (op = cpu_imm8(cpu, TRACE_EX_INST)) {")
+dump_table(op2s, '\t\t', 2)
 print ("\t\t}")
 print ("\t}")
 print ("}")
@@ -33,7 +33,8 @@ enum FieldType : uint32_t
   TYPE_INT16,
   TYPE_INT32,
   TYPE_FLOAT32,
-  TYPE_BOOL
+  TYPE_BOOL,
+  TYPE_UINT64
 };
 
 struct FieldDecl;
@@ -261,8 +262,96 @@ static const StructDecl MachineBuffers = {
         FIELD("framebuffer", Machine::Buffers, framebuffer, TYPE_UINT8, SIZE(LCD_WIDTH *LCD_HEIGHT * sizeof(uint32_t))),
         FIELD("palette", Machine::Buffers, palette, TYPE_UINT32, SIZE(0x100)),
         FIELD("weights", Machine::Buffers, weights, TYPE_FLOAT32, SIZE(0x100)),
+        FIELD("disassembly", Machine::Buffers, disassembly, TYPE_UINT8, SIZE(sizeof(Machine::Buffers::disassembly))),
+        FIELD("transfer", Machine::Buffers, transfer, TYPE_UINT8, SIZE(Machine::TRANSFER_SIZE)),
         {TYPE_END}}};
 
+static const StructDecl ProfileState = {
+    sizeof(Profile::State),
+    (const FieldDecl[]){
+        FIELD("sampling", Profile::State, sampling, TYPE_BOOL),
+        FIELD("interval", Profile::State, interval, TYPE_INT32),
+        FIELD("depth", Profile::State, depth, TYPE_UINT32),
+        FIELD("write_index", Profile::State, write_index, TYPE_UINT32),
+        FIELD("samples", Profile::State, samples, TYPE_UINT32, SIZE(sizeof(Profile::State::samples) / sizeof(uint32_t))),
+        FIELD("callgraph", Profile::State, callgraph, TYPE_BOOL),
+        FIELD("cycles", Profile::State, cycles, TYPE_UINT64),
+        FIELD("edge_count", Profile::State, edge_count, TYPE_UINT32),
+        FIELD("edges_dropped", Profile::State, edges_dropped, TYPE_UINT32),
+        FIELD("edges", Profile::State, edges, TYPE_UINT32, SIZE(sizeof(Profile::State::edges) / sizeof(uint32_t))),
+        {TYPE_END}}};
+
+static const StructDecl StatsCounters = {
+    sizeof(Stats::Counters),
+    (const FieldDecl[]){
+        FIELD("instructions", Stats::Counters, instructions, TYPE_UINT64),
+        FIELD("cycles", Stats::Counters, cycles, TYPE_UINT64),
+        FIELD("halted_cycles", Stats::Counters, halted_cycles, TYPE_UINT64),
+        FIELD("sleeping_cycles", Stats::Counters, sleeping_cycles, TYPE_UINT64),
+        FIELD("clock_calls", Stats::Counters, clock_calls, TYPE_UINT64),
+        FIELD("scanlines", Stats::Counters, scanlines, TYPE_UINT64),
+        FIELD("frames", Stats::Counters, frames, TYPE_UINT64),
+        FIELD("blitter_frames", Stats::Counters, blitter_frames, TYPE_UINT64),
+        FIELD("irqs", Stats::Counters, irqs, TYPE_UINT64, SIZE(IRQ::TOTAL_HARDWARE_IRQS)),
+        FIELD("audio_samples", Stats::Counters, audio_samples, TYPE_UINT64),
+        FIELD("trace_events", Stats::Counters, trace_events, TYPE_UINT64),
+        FIELD("host_ns", Stats::Counters, host_ns, TYPE_UINT64, SIZE(Stats::TOTAL_SUBSYSTEMS)),
+        {TYPE_END}}};
+
+static const StructDecl DebuggerState = {
+    sizeof(Debugger::State),
+    (const FieldDecl[]){
+        FIELD("stop_reason", Debugger::State, stop_reason, TYPE_UINT8),
+        FIELD("stop_address", Debugger::State, stop_address, TYPE_UINT32),
+        FIELD("stop_watchpoint", Debugger::State, stop_watchpoint, TYPE_INT32),
+        FIELD("stop_condition", Debugger::State, stop_condition, TYPE_INT32),
+        FIELD("stop_kind", Debugger::State, stop_kind, TYPE_UINT8),
+        FIELD("stop_access", Debugger::State, stop_access, TYPE_UINT32),
+        FIELD("stop_value", Debugger::State, stop_value, TYPE_UINT8),
+        FIELD("breakpoint_count", Debugger::State, breakpoint_count, TYPE_UINT32),
+        FIELD("condition_error", Debugger::State, condition_error, TYPE_BOOL),
+        FIELD("program_buffer", Debugger::State, program_buffer, TYPE_UINT8, SIZE(Debugger::PROGRAM_LENGTH)),
+        FIELD("log_index", Debugger::State, log_index, TYPE_UINT32),
+        FIELD("log", Debugger::State, log, TYPE_UINT32, SIZE(sizeof(Debugger::State::log) / sizeof(uint32_t))),
+        {TYPE_END}}};
+
+static const StructDecl RewindState = {
+    sizeof(Rewind::State),
+    (const FieldDecl[]){
+        FIELD("recording", Rewind::State, recording, TYPE_BOOL),
+        FIELD("interval", Rewind::State, interval, TYPE_UINT32),
+        FIELD("position", Rewind::State, position, TYPE_UINT64),
+        FIELD("keyframe_index", Rewind::State, keyframe_index, TYPE_UINT32),
+        {TYPE_END}}};
+
+static const StructDecl AnalysisState = {
+    sizeof(Analysis::State),
+    (const FieldDecl[]){
+        FIELD("instructions", Analysis::State, instructions, TYPE_UINT32),
+        FIELD("targets", Analysis::State, targets, TYPE_UINT32),
+        FIELD("unresolved", Analysis::State, unresolved, TYPE_UINT32),
+        FIELD("conflicts", Analysis::State, conflicts, TYPE_UINT32),
+        FIELD("map", Analysis::State, map, TYPE_UINT8, SIZE(Analysis::ADDRESS_SPACE)),
+        {TYPE_END}}};
+
+static const StructDecl TraceState = {
+    sizeof(Trace::State),
+    (const FieldDecl[]){
+        FIELD("enabled", Trace::State, enabled, TYPE_BOOL),
+        FIELD("generation", Trace::State, generation, TYPE_UINT32),
+        FIELD("bank_generation", Trace::State, bank_generation, TYPE_UINT32, SIZE(Trace::BANK_COUNT)),
+        FIELD("attributes", Trace::State, attributes, TYPE_UINT8, SIZE(Trace::ADDRESS_SPACE)),
+        {TYPE_END}}};
+
+#ifdef PROFILE_OPCODES
+static const StructDecl OpcodeProfile = {
+    sizeof(Profile::Opcodes),
+    (const FieldDecl[]){
+        FIELD("executions", Profile::Opcodes, executions, TYPE_UINT64, SIZE(Profile::TOTAL_OPCODES)),
+        FIELD("cycles", Profile::Opcodes, cycles, TYPE_UINT64, SIZE(Profile::TOTAL_OPCODES)),
+        {TYPE_END}}};
+#endif
+
 static const StructDecl MachineState = {
     sizeof(Machine::State),
     (const FieldDecl[]){
@@ -279,10 +368,19 @@ static const StructDecl MachineState = {
         STRUCT("blitter", Machine::State, blitter, BlitterState),
         STRUCT("overlay", Machine::State, overlay, BlitterOverlay),
         STRUCT("timers", Machine::State, timers, TimersState),
+        STRUCT("profile", Machine::State, profile, ProfileState),
+        STRUCT("stats", Machine::State, stats, StatsCounters),
+        STRUCT("debugger", Machine::State, debugger, DebuggerState),
+        STRUCT("rewind", Machine::State, rewind, RewindState),
+        STRUCT("analysis", Machine::State, analysis, AnalysisState),
+        STRUCT("trace", Machine::State, trace, TraceState),
         FIELD("bus_cap", Machine::State, bus_cap, TYPE_UINT8),
         FIELD("clocks", Machine::State, clocks, TYPE_INT32),
         FIELD("osc1_overflow", Machine::State, osc1_overflow, TYPE_INT32),
         FIELD("status", Machine::State, status, TYPE_UINT8),
+#ifdef PROFILE_OPCODES
+        STRUCT("opcodes", Machine::State, opcodes, OpcodeProfile),
+#endif
         {TYPE_END}}};
 
 extern "C" const StructDecl *get_description()
@@ -0,0 +1,311 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+// Mirrors Debugger::Opcode, Debugger::Register and Debugger::ConditionKind
+const OP_END = 0;
+const OP_PUSH = 1;
+const OP_REG = 2;
+const OP_HITS = 3;
+const OP_READ8 = 4;
+const OP_READ16 = 5;
+const OP_AND = 8;
+const OP_SHR = 12;
+const OP_NOT = 21;
+const OP_NEG = 22;
+const OP_JZ = 23;
+const OP_LOG = 24;
+
+const BINARY = {
+  '+': 6,
+  '-': 7,
+  '&': OP_AND,
+  '|': 9,
+  '^': 10,
+  '<<': 11,
+  '>>': OP_SHR,
+  '==': 13,
+  '!=': 14,
+  '<': 15,
+  '<=': 16,
+  '>': 17,
+  '>=': 18,
+  '&&': 19,
+  '||': 20,
+};
+
+// Lowest binding first
+const PRECEDENCE = [
+  ['||'],
+  ['&&'],
+  ['|'],
+  ['^'],
+  ['&'],
+  ['==', '!='],
+  ['<', '<=', '>', '>='],
+  ['<<', '>>'],
+  ['+', '-'],
+];
+
+const REGISTERS = {
+  a: 0,
+  b: 1,
+  l: 2,
+  h: 3,
+  ba: 4,
+  hl: 5,
+  ix: 6,
+  iy: 7,
+  sp: 8,
+  pc: 9,
+  br: 10,
+  ep: 11,
+  xp: 12,
+  yp: 13,
+  nb: 14,
+  cb: 15,
+  sc: 16,
+  ppc: 17,
+};
+
+// Bit positions in SC
+const FLAGS = { zf: 0, cf: 1, vf: 2, nf: 3, df: 4, uf: 5 };
+const REG_SC = 16;
+
+// Only names the table defines itself, nothing inherited from Object
+function named(table: object, token: string) {
+  return Object.prototype.hasOwnProperty.call(table, token);
+}
+
+export const CONDITION_BREAK = 1;
+export const CONDITION_LOG = 2;
+export const PROGRAM_LENGTH = 64;
+
+const TOKEN = /\s*(0x[0-9a-f]+|\$[0-9a-f]+|\d+|[a-z_]\w*|\|\||&&|==|!=|<=|>=|<<|>>|[-+!&|^<>()[\],])/iy;
+
+function tokenize(source: string): string[] {
+  const tokens = [];
+  TOKEN.lastIndex = 0;
+
+  while (TOKEN.lastIndex < source.length) {
+    const start = TOKEN.lastIndex;
+    const match = TOKEN.exec(source);
+
+    if (!match) {
+      if (!source.slice(start).trim()) break;
+      throw new Error(`Unexpected input at "${source.slice(start)}"`);
+    }
+
+    tokens.push(match[1].toLowerCase());
+  }
+
+  return tokens;
+}
+
+/**
+ * Compile expressions like "a == 3 && [0x1c40] > 10 && zf" into core bytecode.
+ * [x] and byte[x] read a byte, word[x] a little endian word, hits counts the
+ * times the address was reached and ppc is the physical PC.
+ */
+class Compiler {
+  private tokens: string[];
+  private index = 0;
+  public code: number[] = [];
+
+  constructor(source: string) {
+    this.tokens = tokenize(source);
+  }
+
+  private peek() {
+    return this.tokens[this.index];
+  }
+
+  private next() {
+    if (this.index >= this.tokens.length) {
+      throw new Error('Unexpected end of expression');
+    }
+    return this.tokens[this.index++];
+  }
+
+  private expect(token: string) {
+    const found = this.next();
+    if (found !== token) {
+      throw new Error(`Expected "${token}", found "${found}"`);
+    }
+  }
+
+  get done() {
+    return this.index >= this.tokens.length;
+  }
+
+  push(value: number) {
+    this.code.push(
+      OP_PUSH,
+      value & 0xff,
+      (value >> 8) & 0xff,
+      (value >> 16) & 0xff,
+      (value >> 24) & 0xff,
+    );
+  }
+
+  list(condition?: Compiler) {
+    let skip = 0;
+
+    if (condition) {
+      this.code.push(...condition.code, OP_JZ, 0);
+      skip = this.code.length;
+    }
+
+    this.expression();
+    while (this.peek() === ',') {
+      this.next();
+      this.code.push(OP_LOG);
+      this.expression();
+    }
+    this.code.push(OP_LOG);
+
+    if (condition) {
+      this.code[skip - 1] = this.code.length - skip;
+    }
+  }
+
+  expression(level = 0) {
+    if (level >= PRECEDENCE.length) {
+      this.unary();
+      return;
+    }
+
+    this.expression(level + 1);
+
+    while (PRECEDENCE[level].indexOf(this.peek()) >= 0) {
+      const op = this.next();
+      this.expression(level + 1);
+      this.code.push(BINARY[op]);
+    }
+  }
+
+  private unary() {
+    const token = this.peek();
+
+    if (token === '!' || token === '-') {
+      this.next();
+      this.unary();
+      this.code.push(token === '!' ? OP_NOT : OP_NEG);
+    } else {
+      this.primary();
+    }
+  }
+
+  private primary() {
+    const token = this.next();
+
+    if (token === '(') {
+      this.expression();
+      this.expect(')');
+    } else if (token === '[' || token === 'byte' || token === 'word') {
+      if (token !== '[') this.expect('[');
+      this.expression();
+      this.expect(']');
+      this.code.push(token === 'word' ? OP_READ16 : OP_READ8);
+    } else if (token === 'hits') {
+      this.code.push(OP_HITS);
+    } else if (named(REGISTERS, token)) {
+      this.code.push(OP_REG, REGISTERS[token]);
+    } else if (named(FLAGS, token)) {
+      this.code.push(OP_REG, REG_SC);
+      this.push(FLAGS[token]);
+      this.code.push(OP_SHR);
+      this.push(1);
+      this.code.push(OP_AND);
+    } else if (/^(0x[0-9a-f]+|\$[0-9a-f]+|\d+)$/.test(token)) {
+      this.push(parseInt(token.replace('$', '0x')));
+    } else {
+      throw new Error(`Unknown symbol "${token}"`);
+    }
+  }
+}
+
+function finish(compiler: Compiler) {
+  if (!compiler.done) {
+    throw new Error('Unexpected trailing input');
+  }
+
+  compiler.code.push(OP_END);
+
+  if (compiler.code.length > PROGRAM_LENGTH) {
+    throw new Error('Expression is too long');
+  }
+
+  return Uint8Array.from(compiler.code);
+}
+
+export function compileCondition(source: string): Uint8Array {
+  const compiler = new Compiler(source);
+  compiler.expression();
+  return finish(compiler);
+}
+
+// Comma separated expressions, each one is logged in order when the optional condition holds
+export function compileLogpoint(source: string, condition?: string): Uint8Array {
+  const compiler = new Compiler(source);
+  let guard;
+
+  if (condition) {
+    guard = new Compiler(condition);
+    guard.expression();
+
+    if (!guard.done) {
+      throw new Error('Unexpected trailing input');
+    }
+  }
+
+  compiler.list(guard);
+  return finish(compiler);
+}
+
+export interface LogEntry {
+  address: number;
+  condition: number;
+  item: number;
+  value: number;
+}
+
+// Mirrors Debugger::LogEntry, three words
+const LOG_WORDS = 3;
+const LOG_COUNT = 1024;
+
+/**
+ * Entries logged since sequence number `since`, along with the sequence
+ * number to pass next time. Entries overwritten in the ring are skipped.
+ */
+export function readLog(debugger_state, since: number) {
+  const { log, log_index } = debugger_state;
+  const entries: LogEntry[] = [];
+
+  for (let i = Math.max(since, log_index - LOG_COUNT); i < log_index; i++) {
+    const base = (i % LOG_COUNT) * LOG_WORDS;
+
+    entries.push({
+      address: log[base],
+      condition: log[base + 1] & 0xffff,
+      item: log[base + 1] >>> 16,
+      value: log[base + 2] | 0,
+    });
+  }
+
+  return { entries, next: log_index };
+}
@@ -0,0 +1,88 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+// Mirrors Disassembler::Record in src/core/include/disassembler.h
+export const BUFFER_RECORDS = 1024;
+const RECORD_BYTES = 20;
+
+export const NO_TARGET = 0xffffffff;
+export const ARGUMENT_NONE = 0xff;
+
+export const RECORD_UNDEFINED = 1;
+export const RECORD_BRANCH = 2;
+export const RECORD_CALL = 4;
+export const RECORD_RETURN = 8;
+export const RECORD_STOP = 16;
+export const RECORD_SETS_BANK = 32;
+
+// Mirrors Analysis::Attribute in src/core/include/analysis.h
+export const ATTR_CODE = 1;
+export const ATTR_OPERAND = 2;
+export const ATTR_BRANCH = 4;
+export const ATTR_CALL = 8;
+export const ATTR_ENTRY = 16;
+export const ATTR_VECTOR = 32;
+export const ATTR_CONFLICT = 64;
+
+export interface DisassemblyRecord {
+  address: number;
+  target: number;
+  opcode: number;
+  operands: number[];
+  length: number;
+  operation: number; // Index into Operations in core/instructions
+  condition: number;
+  flags: number;
+  arguments: number[];
+}
+
+/**
+ * Decode the records disassemble() wrote into the shared buffer
+ */
+export function readRecords(
+  buffer: Uint8Array,
+  count: number,
+): DisassemblyRecord[] {
+  const view = new DataView(
+    buffer.buffer,
+    buffer.byteOffset,
+    buffer.byteLength,
+  );
+  const records: DisassemblyRecord[] = [];
+
+  for (let i = 0; i < count; i++) {
+    const base = i * RECORD_BYTES;
+
+    records.push({
+      address: view.getUint32(base, true),
+      target: view.getUint32(base + 4, true),
+      opcode: view.getUint16(base + 8, true),
+      operands: [
+        view.getUint16(base + 10, true),
+        view.getUint16(base + 12, true),
+      ],
+      length: view.getUint8(base + 14),
+      operation: view.getUint8(base + 15),
+      condition: view.getUint8(base + 16),
+      flags: view.getUint8(base + 17),
+      arguments: [view.getUint8(base + 18), view.getUint8(base + 19)],
+    });
+  }
+
+  return records;
+}
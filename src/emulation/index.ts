@@ -22,6 +22,15 @@ import Audio from './audio';
 
 import AssemblyCore from '../../assets/libminimon.wasm';
 import Tracer from './trace';
+import { foldSamples, callGraph } from './profile';
+import {
+  compileCondition,
+  compileLogpoint,
+  readLog,
+  CONDITION_BREAK,
+  CONDITION_LOG,
+} from './condition';
+import { readRecords, BUFFER_RECORDS } from './disassembly';
 
 const KEYBOARD_CODES = {
   67: 0b00000001,
@@ -35,8 +44,29 @@ const KEYBOARD_CODES = {
 };
 
 const INPUT_CART_N = 0b1000000000;
+
+// Mirrors Debugger::WatchKind
+export const WATCH_READ = 1;
+export const WATCH_WRITE = 2;
+export const WATCH_EXECUTE = 4;
 const CPU_FREQ = 4000000;
 
+// Mirrors LCD::FrameFormat
+export const FRAME_RGBA32 = 0;
+export const FRAME_1BPP = 1;
+export const FRAME_INTENSITY8 = 2;
+export const FRAME_RGB565 = 3;
+
+const FRAME_SIZES = {
+  [FRAME_RGBA32]: 96 * 64 * 4,
+  [FRAME_1BPP]: (96 / 8) * 64,
+  [FRAME_INTENSITY8]: 96 * 64,
+  [FRAME_RGB565]: 96 * 64 * 2,
+};
+
+// Steps between rewind keyframes, the core keeps the last 32
+const REWIND_INTERVAL = 100000;
+
 export default class Minimon extends EventTarget {
   public state: Object | null;
 
@@ -89,12 +119,6 @@ export default class Minimon extends EventTarget {
     const request = await fetch(AssemblyCore);
     const wasm = await WebAssembly.instantiate(await request.arrayBuffer(), {
       env: {
-        trace_access: (
-          cpu: number,
-          address: number,
-          kind: number,
-          data: number,
-        ) => inst.tracer.traceAccess(cpu, address, kind, data),
         audio_push: () => {
           inst.audio.push(inst.state.buffers.audio);
         },
@@ -120,7 +144,10 @@ export default class Minimon extends EventTarget {
       inst.cpu_state,
     );
     inst.tracer = new Tracer(inst);
+    inst.exports.trace_enable(inst.cpu_state, true);
     inst.exports.cpu_initialize(inst.cpu_state);
+    inst.exports.rewind_enable(inst.cpu_state, REWIND_INTERVAL);
+    inst.analyzeCode();
 
     return inst;
   }
@@ -153,19 +180,14 @@ export default class Minimon extends EventTarget {
 
     this.systemTime = now;
 
-    if (this.breakpoints.length) {
-      this.state.clocks += delta; // advance our clock
-
-      while (this.state.clocks > 0) {
-        if (this.breakpoints.indexOf(this.physicalPC()) >= 0) {
-          this.running = false;
-          break;
-        }
+    if (this.exports.cpu_advance(this.cpu_state, delta)) {
+      // Stopped on a breakpoint or watchpoint, the rest of this time slice is dropped
+      this.state.clocks = 0;
+      this.running = false;
 
-        this.exports.cpu_step(this.cpu_state);
-      }
-    } else {
-      this.exports.cpu_advance(this.cpu_state, delta);
+      this.dispatchEvent(
+        new CustomEvent('update:stopped', { detail: { ...this.state.debugger } }),
+      );
     }
 
     this.update();
@@ -183,8 +205,10 @@ export default class Minimon extends EventTarget {
 
     if (index >= 0) {
       this.breakpoints.splice(index, 1);
+      this.exports.breakpoint_clear(this.cpu_state, address);
     } else {
       this.breakpoints.push(address);
+      this.exports.breakpoint_set(this.cpu_state, address);
     }
 
     this.dispatchEvent(
@@ -192,6 +216,50 @@ export default class Minimon extends EventTarget {
     );
   }
 
+  // Returns the watchpoint index, or -1 when the core has no free slot
+  setWatchpoint(start: number, end: number, kinds: number) {
+    return this.exports.watchpoint_set(this.cpu_state, start, end, kinds);
+  }
+
+  clearWatchpoint(index: number) {
+    this.exports.watchpoint_clear(this.cpu_state, index);
+  }
+
+  // Conditional breakpoints and logpoints, returns the slot or -1 when full
+  setCondition(address: number, condition: string) {
+    return this.installCondition(
+      address,
+      CONDITION_BREAK,
+      compileCondition(condition),
+    );
+  }
+
+  setLogpoint(address: number, expressions: string, condition?: string) {
+    return this.installCondition(
+      address,
+      CONDITION_LOG,
+      compileLogpoint(expressions, condition),
+    );
+  }
+
+  clearCondition(slot: number) {
+    this.exports.condition_clear(this.cpu_state, slot);
+  }
+
+  // Logged values since the `next` returned by the previous call
+  readLog(since = 0) {
+    return readLog(this.state.debugger, since);
+  }
+
+  private installCondition(address: number, kind: number, program: Uint8Array) {
+    const buffer = this.state.debugger.program_buffer;
+
+    buffer.fill(0);
+    buffer.set(program);
+
+    return this.exports.condition_set(this.cpu_state, address, kind);
+  }
+
   private updateInput() {
     this.exports.update_inputs(this.cpu_state, this.inputState);
   }
@@ -234,6 +302,8 @@ export default class Minimon extends EventTarget {
         Math.min(0xff, Math.floor(g * 0x100)) * 0x0100 +
         Math.min(0xff, Math.floor(b * 0x100)) * 0x010000;
     }
+
+    this.exports.palette_changed(this.cpu_state);
   }
 
   setBlendWeights(weights) {
@@ -250,6 +320,8 @@ export default class Minimon extends EventTarget {
         this.state.buffers.weights[i] += scaledWeight;
       }
     }
+
+    this.exports.palette_changed(this.cpu_state);
   }
 
   // Cartridge I/O
@@ -261,6 +333,9 @@ export default class Minimon extends EventTarget {
     this.eject();
     for (let i = bytes.length - 1; i >= 0; i--)
       this.state.buffers.cartridge[(i + offset) & 0x1fffff] = bytes[i];
+    this.exports.cartridge_changed(this.cpu_state);
+
+    this.analyzeCode();
 
     setTimeout(() => {
       this.inputState &= ~INPUT_CART_N;
@@ -268,13 +343,52 @@ export default class Minimon extends EventTarget {
     }, 100);
   }
 
+  // Static code discovery from the vectors, shown until execution traces it
+  analyzeCode() {
+    this.exports.analyze_code(this.cpu_state);
+    this.tracer.invalidate();
+  }
+
   eject() {
     this.dispatchEvent(new Event('update:cartridgeChanged'));
+    this.exports.trace_reset(this.cpu_state);
     this.tracer.reset(this);
     this.inputState |= INPUT_CART_N;
     this.updateInput();
   }
 
+  // Sampling profiler, interval is in CPU cycles (0 disables)
+  setSampling(interval: number) {
+    this.exports.set_sampling(this.cpu_state, interval);
+  }
+
+  foldedSamples() {
+    return foldSamples(this.state.profile);
+  }
+
+  // Exact call graph, enabling clears the previous table and disabling keeps it
+  setCallGraph(enabled: boolean) {
+    this.exports.set_callgraph(this.cpu_state, enabled);
+  }
+
+  callGraph() {
+    return callGraph(this.state.profile);
+  }
+
+  // Snapshot of the core's monotonic counters, arrays stay per vector / subsystem
+  stats() {
+    const { stats } = this.state;
+    const out = {};
+
+    for (const key of Object.keys(stats)) {
+      const value = stats[key];
+      out[key] =
+        typeof value === 'bigint' ? Number(value) : Array.from(value, Number);
+    }
+
+    return out;
+  }
+
   physicalPC() {
     const address = this.state.cpu.pc;
     if (address & 0x8000) {
@@ -288,14 +402,118 @@ export default class Minimon extends EventTarget {
     this.update();
   }
 
+  // Reverse execution, these return false when history doesn't reach back far enough
+  stepBack() {
+    const moved = this.exports.cpu_step_back(this.cpu_state);
+    this.update();
+    return moved;
+  }
+
+  reverseStepOver() {
+    const moved = this.exports.cpu_reverse_step_over(this.cpu_state);
+    this.update();
+    return moved;
+  }
+
+  reverseContinue() {
+    const reason = this.exports.cpu_reverse_continue(this.cpu_state);
+    this.update();
+    return reason;
+  }
+
+  // Converts the last completed frame into state.buffers.framebuffer,
+  // bit y of the result is set when row y changed since the last call
+  getFrame(): bigint {
+    return this.exports.get_frame(this.cpu_state, FRAME_RGBA32);
+  }
+
+  // Copies the last completed frame in any format, changed or not
+  readFrame(format: number): Uint8Array {
+    const { transfer } = this.state.buffers;
+    const size = FRAME_SIZES[format];
+
+    if (size === undefined) {
+      throw new Error(`Unknown frame format ${format}`);
+    }
+
+    this.exports.read_frame(this.cpu_state, format, transfer.byteOffset);
+    return transfer.slice(0, size);
+  }
+
+  // Bit n of the result is set when trace bank n changed after generation
+  traceChanged(generation: number): bigint {
+    return this.exports.trace_changed_banks(this.cpu_state, generation);
+  }
+
+  traceSet(address: number, attributes: number) {
+    this.exports.trace_set(this.cpu_state, address, attributes);
+  }
+
+  // Decodes up to count instructions from a physical address, without side effects
+  disassemble(address: number, count: number) {
+    const buffer = this.state.buffers.disassembly;
+    const written = this.exports.disassemble(
+      this.cpu_state,
+      address,
+      Math.min(count, BUFFER_RECORDS),
+      buffer.byteOffset,
+    );
+
+    return readRecords(buffer, written);
+  }
+
   reset() {
     this.exports.cpu_reset(this.cpu_state);
     this.updateInput();
     this.update();
   }
 
-  read(address) {
-    return this.exports.cpu_read(this.cpu_state, address);
+  // Side effect free, so the debugger panels never disturb the machine
+  read(address: number) {
+    const { transfer } = this.state.buffers;
+
+    this.exports.peek_block(this.cpu_state, address, 1, transfer.byteOffset);
+    return transfer[0];
+  }
+
+  // Views refreshed often can pass the same out array every time
+  peekBlock(
+    address: number,
+    length: number,
+    out: Uint8Array = new Uint8Array(length),
+  ) {
+    const { transfer } = this.state.buffers;
+
+    for (let offset = 0; offset < length; offset += transfer.length) {
+      const count = Math.min(transfer.length, length - offset);
+
+      this.exports.peek_block(
+        this.cpu_state,
+        address + offset,
+        count,
+        transfer.byteOffset,
+      );
+      out.set(transfer.subarray(0, count), offset);
+    }
+
+    return out;
+  }
+
+  // RAM, BIOS and cartridge only, I/O registers are left alone
+  pokeBlock(address: number, bytes: Uint8Array) {
+    const { transfer } = this.state.buffers;
+
+    for (let offset = 0; offset < bytes.length; offset += transfer.length) {
+      const count = Math.min(transfer.length, bytes.length - offset);
+
+      transfer.set(bytes.subarray(offset, offset + count));
+      this.exports.poke_block(
+        this.cpu_state,
+        address + offset,
+        count,
+        transfer.byteOffset,
+      );
+    }
   }
 
   write(data, address) {
@@ -0,0 +1,92 @@
+/*
+ISC License
+
+Copyright (c) 2019, Bryon Vandiver
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+// Mirrors Profile::Sample in src/core/include/profile.h
+const SAMPLE_DEPTH = 16;
+const SAMPLE_COUNT = 4096;
+const SAMPLE_WORDS = SAMPLE_DEPTH + 2;
+
+// Mirrors Profile::Edge
+const EDGE_WORDS = 8;
+
+function label(address: number) {
+  return `loc_${address.toString(16)}`;
+}
+
+/**
+ * Fold the sampler ring into "root;caller;callee count" lines, the
+ * input format of flamegraph.pl, speedscope and friends
+ */
+export function foldSamples(profile, name = label): string {
+  const { samples } = profile;
+  const total = Math.min(profile.write_index, SAMPLE_COUNT);
+  const stacks = new Map<string, number>();
+
+  for (let i = 0; i < total; i++) {
+    const base = i * SAMPLE_WORDS;
+    const depth = samples[base + 1];
+    const frames = Math.min(depth, SAMPLE_DEPTH);
+    const stack = depth > frames ? ['...'] : [];
+
+    for (let f = 0; f < frames; f++) {
+      stack.push(name(samples[base + 2 + f]));
+    }
+
+    if (!stack.length) {
+      stack.push('(top level)');
+    }
+
+    const key = stack.join(';');
+    stacks.set(key, (stacks.get(key) || 0) + 1);
+  }
+
+  return Array.from(stacks, ([stack, count]) => `${stack} ${count}`).join(
+    '\n',
+  );
+}
+
+export interface CallEdge {
+  site: number;
+  target: number;
+  calls: number;
+  inclusive: number;
+  exclusive: number;
+}
+
+/**
+ * Decode the call graph edge table, most expensive callees first
+ */
+export function callGraph(profile): CallEdge[] {
+  const { edges } = profile;
+  const result: CallEdge[] = [];
+  const u64 = (i: number) => edges[i] + edges[i + 1] * 0x100000000;
+
+  for (let i = 0; i < profile.edge_count; i++) {
+    const base = i * EDGE_WORDS;
+
+    result.push({
+      site: edges[base + 0],
+      target: edges[base + 1],
+      calls: edges[base + 2],
+      inclusive: u64(base + 4),
+      exclusive: u64(base + 6),
+    });
+  }
+
+  return result.sort((a, b) => b.inclusive - a.inclusive);
+}
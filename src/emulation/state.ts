@@ -28,6 +28,7 @@ const TYPE_INT16 = 6;
 const TYPE_INT32 = 7;
 const TYPE_FLOAT32 = 8;
 const TYPE_BOOL = 9;
+const TYPE_UINT64 = 10;
 
 const SIZES = {
   [TYPE_UINT8]: 1,
@@ -38,6 +39,7 @@ const SIZES = {
   [TYPE_INT32]: 4,
   [TYPE_FLOAT32]: 4,
   [TYPE_BOOL]: 1,
+  [TYPE_UINT64]: 8,
 };
 
 const GETTERS = {
@@ -49,6 +51,7 @@ const GETTERS = {
   [TYPE_INT32]: 'getInt32',
   [TYPE_FLOAT32]: 'getFloat32',
   [TYPE_BOOL]: 'getUint8',
+  [TYPE_UINT64]: 'getBigUint64',
 };
 
 const SETTERS = {
@@ -60,6 +63,7 @@ const SETTERS = {
   [TYPE_INT32]: 'setInt32',
   [TYPE_FLOAT32]: 'setFloat32',
   [TYPE_BOOL]: 'setUint8',
+  [TYPE_UINT64]: 'setBigUint64',
 };
 
 const ARRAYTYPE = {
@@ -71,6 +75,7 @@ const ARRAYTYPE = {
   [TYPE_INT32]: Int32Array,
   [TYPE_FLOAT32]: Float32Array,
   [TYPE_BOOL]: Uint8Array,
+  [TYPE_UINT64]: BigUint64Array,
 };
 
 function utf8(dv, offset) {
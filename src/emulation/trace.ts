@@ -18,30 +18,34 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 import Minimon from '.';
 import * as Table from '../core/instructions';
+import {
+  DisassemblyRecord,
+  ARGUMENT_NONE,
+  NO_TARGET,
+  RECORD_BRANCH,
+  RECORD_RETURN,
+  RECORD_UNDEFINED,
+  ATTR_CODE,
+  ATTR_BRANCH,
+  ATTR_CALL,
+  ATTR_ENTRY,
+} from './disassembly';
 
 const MAX_DATA_WORDS = 5;
 const MAX_DATA_BYTES = 10;
 const IllegalInstruction = 'NDEF';
 
-const BreakInstructions = [
-  'CALL',
-  'CARS',
-  'CARL',
-  'JRS',
-  'JRL',
-  'JP',
-  'DJR',
-  'RET',
-  'RETS',
-  'RETI',
-  IllegalInstruction,
-];
+// Lines after these start a new run, which is only decoded when traced
+const BreakFlags = RECORD_BRANCH | RECORD_RETURN | RECORD_UNDEFINED;
+
+// Instructions decoded per call into the core
+const RUN_RECORDS = 64;
 
 const Conditions = {
   [Table.Condition.LESS_THAN]: 'LT',
   [Table.Condition.LESS_EQUAL]: 'LE',
   [Table.Condition.GREATER_THAN]: 'GT',
-  [Table.Condition.GREATER_EQUAL]: 'LE',
+  [Table.Condition.GREATER_EQUAL]: 'GE',
   [Table.Condition.OVERFLOW]: 'V',
   [Table.Condition.NOT_OVERFLOW]: 'NV',
   [Table.Condition.POSITIVE]: 'P',
@@ -60,61 +64,118 @@ const Conditions = {
   [Table.Condition.NOT_SPECIAL_FLAG_3]: 'NF3',
 };
 
+const Registers = {
+  [Table.Argument.REGS_ALL]: 'ALL',
+  [Table.Argument.REGS_ALE]: 'ALE',
+  [Table.Argument.REG_A]: 'A',
+  [Table.Argument.REG_B]: 'B',
+  [Table.Argument.REG_L]: 'L',
+  [Table.Argument.REG_H]: 'H',
+  [Table.Argument.REG_BA]: 'BA',
+  [Table.Argument.REG_HL]: 'HL',
+  [Table.Argument.REG_IX]: 'IX',
+  [Table.Argument.REG_IY]: 'IY',
+  [Table.Argument.REG_NB]: 'NB',
+  [Table.Argument.REG_BR]: 'BR',
+  [Table.Argument.REG_EP]: 'EP',
+  [Table.Argument.REG_IP]: 'IP',
+  [Table.Argument.REG_XP]: 'XP',
+  [Table.Argument.REG_YP]: 'YP',
+  [Table.Argument.REG_SC]: 'SC',
+  [Table.Argument.REG_SP]: 'SP',
+  [Table.Argument.REG_PC]: 'PC',
+};
+
 const HTMLComma = "<span class='symbol'>,</span> ";
 
 function BIT(n: number) {
   return 1 << n;
 }
 
+// Per byte attributes kept by the core (Trace::Attribute in tracing.h)
 export enum TraceAccess {
   NONE = 0,
-
-  // Category: Access Type
   WORD_LO = BIT(0),
-  WORD_HI = BIT(1),
-  DATA = BIT(2),
-  INSTRUCTION = BIT(3),
-  EX_INST = BIT(4),
-  IMMEDIATE = BIT(5),
-  STACK = BIT(6),
-
-  // Category: Argument type
-  VECTOR = BIT(10),
-  BRANCH_TARGET = BIT(11),
-  OFFSET = BIT(12),
-
-  // Category: Data type
-  TILE_DATA = BIT(20),
-  SPRITE_DATA = BIT(21),
-  RETURN_ADDRESS = BIT(22),
-
-  // Category: Access direction
-  READ = BIT(30),
-  WRITE = BIT(31),
+  DATA = BIT(1),
+  INSTRUCTION = BIT(2),
+  STACK = BIT(3),
+  VECTOR = BIT(4),
+  BRANCH_TARGET = BIT(5),
+  RETURN_ADDRESS = BIT(6),
+  GRAPHICS = BIT(7),
 }
 
+// The core tracks attribute changes per 32KB bank
+const BANK_COUNT = 64;
+
 function format(v, d = 2) {
   const o = `00000${v.toString(16).toUpperCase()}`;
   return `${o.substring(o.length - d)}`;
 }
 
+function signed(val) {
+  if (val > 0) {
+    return `+${val}`;
+  }
+  return val.toString();
+}
+
+function register(name) {
+  return `<span class="register">${name}</span>`;
+}
+
+function memory(...parts) {
+  return `<span class="symbol">[</span>${parts.join('')}<span class="symbol">]</span>`;
+}
+
+/**
+ * Instruction lines build their HTML on first use, so only the rows the
+ * debugger scrolls into view pay for formatting
+ */
+class InstructionLine {
+  public address: number;
+  public operation: string;
+  public label?: string;
+
+  private tracer: Tracer;
+  private record: DisassemblyRecord;
+  private bytes: Uint8Array;
+  private html?: string;
+
+  constructor(tracer: Tracer, record: DisassemblyRecord, bytes: Uint8Array) {
+    this.tracer = tracer;
+    this.record = record;
+    this.bytes = bytes;
+    this.address = record.address;
+    this.operation = Table.Operations[record.operation];
+  }
+
+  get parameters() {
+    if (this.html === undefined) {
+      this.html = this.tracer.formatParameters(this.record);
+    }
+    return this.html;
+  }
+
+  get raw() {
+    return Array.from(this.bytes, (v) => format(v)).join(' ');
+  }
+}
+
 export default class Tracer extends EventTarget {
-  private trace: Uint32Array;
+  private trace: Uint8Array;
 
   private traceBank: Object;
 
-  private dirty: Object;
-
-  private labels: Object;
+  private generation: number;
 
   private system: Minimon;
 
   constructor(system: Minimon) {
     super();
 
-    this.trace = new Uint32Array(0x200000);
-    this.dirty = {};
-    this.labels = {};
+    this.trace = system.state.trace.attributes;
+    this.generation = system.state.trace.generation;
     this.system = system;
 
     this.traceBank = {
@@ -152,10 +213,6 @@ export default class Tracer extends EventTarget {
         name: `ROM Bank ${bank} (${format(address, 6)}~${format(end, 6)})`,
       };
     }
-
-    for (let i = 0x1000; i < this.trace.length; i++) {
-      this.trace[i] = TraceAccess.NONE;
-    }
   }
 
   getPages() {
@@ -176,7 +233,6 @@ export default class Tracer extends EventTarget {
     const render = (bank.render = []);
     let { address, data } = bank;
     let index = 0;
-    let jumpPage = address & ~0x7fff;
 
     function i8() {
       return address++, data[index++];
@@ -184,170 +240,47 @@ export default class Tracer extends EventTarget {
     function i16() {
       return i8() | (i8() << 8);
     }
-    function s8() {
-      return (i8() << 24) >> 24;
-    }
-    function s16() {
-      return (i16() << 16) >> 16;
-    }
-
-    const pcRelative = (v) => {
-      const rel = v & 0x8000 ? jumpPage | (v & 0x7fff) : v;
-
-      if (this.labels[rel]) {
-        return `<span class="identifier" data-address="${rel}">${this.labels[rel]}</span>`;
-      }
-      return `<span class="literal" data-address="${rel}">#${format(rel, 6)}h</literal>`;
-    };
-
-    function signed(val) {
-      if (val > 0) {
-        return `+${val}`;
-      }
-      return val.toString();
-    }
-
-    function arg(arg) {
-      let val;
-
-      switch (arg) {
-        case Table.Argument.REGS_ALL:
-          return '<span class="register">ALL</span>';
-        case Table.Argument.REGS_ALE:
-          return '<span class="register">ALE</span>';
-        case Table.Argument.REG_A:
-          return '<span class="register">A</span>';
-        case Table.Argument.REG_B:
-          return '<span class="register">B</span>';
-        case Table.Argument.REG_L:
-          return '<span class="register">L</span>';
-        case Table.Argument.REG_H:
-          return '<span class="register">H</span>';
-        case Table.Argument.REG_BA:
-          return '<span class="register">BA</span>';
-        case Table.Argument.REG_HL:
-          return '<span class="register">HL</span>';
-        case Table.Argument.REG_IX:
-          return '<span class="register">IX</span>';
-        case Table.Argument.REG_IY:
-          return '<span class="register">IY</span>';
-        case Table.Argument.REG_NB:
-          return '<span class="register">NB</span>';
-        case Table.Argument.REG_BR:
-          return '<span class="register">BR</span>';
-        case Table.Argument.REG_EP:
-          return '<span class="register">EP</span>';
-        case Table.Argument.REG_IP:
-          return '<span class="register">IP</span>';
-        case Table.Argument.REG_XP:
-          return '<span class="register">XP</span>';
-        case Table.Argument.REG_YP:
-          return '<span class="register">YP</span>';
-        case Table.Argument.REG_SC:
-          return '<span class="register">SC</span>';
-        case Table.Argument.REG_SP:
-          return '<span class="register">SP</span>';
-        case Table.Argument.REG_PC:
-          return '<span class="register">PC</span>';
-        case Table.Argument.MEM_HL:
-          return '<span class="symbol">[</span><span class="register">HL</span><span class="symbol">]</span>';
-        case Table.Argument.MEM_IX:
-          return '<span class="symbol">[</span><span class="register">IX</span><span class="symbol">]</span>';
-        case Table.Argument.MEM_IY:
-          return '<span class="symbol">[</span><span class="register">IY</span><span class="symbol">]</span>';
-        case Table.Argument.MEM_IX_OFF:
-          return '<span class="symbol">[</span><span class="register">IX</span><span class="symbol">+</span><span class="register">L</span><span class="symbol">]</span>';
-        case Table.Argument.MEM_IY_OFF:
-          return '<span class="symbol">[</span><span class="register">IY</span><span class="symbol">+</span><span class="register">L</span><span class="symbol">]</span>';
-        case Table.Argument.MEM_SP_DISP:
-          return `[SP${signed(s8())}]`;
-        case Table.Argument.MEM_IX_DISP:
-          return `[IX${signed(s8())}]`;
-        case Table.Argument.MEM_IY_DISP:
-          return `[IY${signed(s8())}]`;
-        case Table.Argument.MEM_ABS16:
-          return `<span class="symbol">[</span><span class="literal">0${format(i16(), 4)}h</span><span class="symbol">]</span>`;
-        case Table.Argument.MEM_BR:
-          return `<span class="symbol">[</span><span class="register">BR</span><span class="symbol">:</span><span class="literal">0${format(i8())}h</span><span class="symbol">]</span>`;
-        case Table.Argument.MEM_VECTOR:
-          return `<span class="symbol">[</span><span class="literal">0${format(i8())}h</span><span class="symbol">]</span>`;
-        case Table.Argument.IMM_8:
-          return `<span class="literal">#0${format(i8())}h</span>`;
-        case Table.Argument.IMM_16:
-          return `<span class="literal">#0${format(i16(), 4)}h</span>`;
-        case Table.Argument.REL_8:
-          return pcRelative(address + s8());
-        case Table.Argument.REL_16:
-          return pcRelative(address + s16());
-      }
-    }
 
     let trace = this.trace[address];
-    jumpPage = address & ~0x7fff;
     while (index < data.length) {
-      if (trace & TraceAccess.INSTRUCTION) {
+      if (this.isCode(address)) {
+        let records = [];
+        let next = 0;
         let terminate = false;
 
         do {
-          const startAddress = address;
-          const startIndex = index;
-
-          // Pull opcode out of table
-          let opcode = Table.InstructionTable;
-          do {
-            opcode = opcode[i8()];
-          } while (Array.isArray(opcode));
-
-          let operation;
-          let parameters;
-
-          if (opcode) {
-            const { op, condition, args } = opcode;
-
-            operation = op;
-            parameters = args.map(arg);
-
-            if (condition !== Table.Condition.NONE) {
-              parameters.unshift(
-                `<span class="condition">${Conditions[opcode.condition]}</span>`,
-              );
-            }
-
-            if (index > data.length) {
-              operation = IllegalInstruction;
-              parameters = [];
-              index = data.length;
-              terminate = true;
-            } else if (BreakInstructions.indexOf(operation) >= 0) {
-              terminate = true;
-            } else if (
-              operation === 'LD' &&
-              args[0] == Table.Argument.REG_NB &&
-              args[1] == Table.Argument.IMM_8
-            ) {
-              jumpPage = data[index - 1] << 15;
-            } else {
-              jumpPage = address & ~0x7fff;
-            }
-          } else {
-            operation = IllegalInstruction;
-            parameters = [];
-            terminate = true;
+          // The core decodes runs in batches, most end at a branch well before this
+          if (next >= records.length) {
+            records = this.system.disassemble(address, RUN_RECORDS);
+            next = 0;
           }
 
-          // Format raw data
-          const raw = [];
-          for (let i = startIndex; i < index; i++) {
-            raw.push(format(data[i]));
+          const record = records[next++];
+
+          if (index + record.length > data.length) {
+            render.push({
+              operation: IllegalInstruction,
+              address,
+              parameters: '',
+              raw: Array.from(data.subarray(index), (v) => format(v)).join(' '),
+            });
+
+            address += data.length - index;
+            index = data.length;
+            break;
           }
 
-          render.push({
-            operation,
-            address: startAddress,
-            parameters: parameters.join(HTMLComma),
-            raw: raw.join(' '),
-          });
+          render.push(
+            new InstructionLine(
+              this,
+              record,
+              data.slice(index, index + record.length),
+            ),
+          );
 
+          address += record.length;
+          index += record.length;
+          terminate = (record.flags & BreakFlags) !== 0;
           trace = this.trace[address];
         } while (index < data.length && !terminate);
       } else if (data.length - index >= 2 && trace & TraceAccess.WORD_LO) {
@@ -359,9 +292,9 @@ export default class Tracer extends EventTarget {
           const wordAddr = address;
           const word = i16();
 
-          if (trace & TraceAccess.VECTOR && this.labels[word]) {
+          if (trace & TraceAccess.VECTOR && this.label(word)) {
             parameters.push(
-              `<span class="identifier" data-address="${wordAddr}">${this.labels[word]}</span>`,
+              `<span class="identifier" data-address="${wordAddr}">${this.label(word)}</span>`,
             );
           } else {
             parameters.push(
@@ -373,7 +306,7 @@ export default class Tracer extends EventTarget {
         } while (
           parameters.length < MAX_DATA_WORDS &&
           data.length - index >= 2 &&
-          !this.labels[address] &&
+          !this.label(address) &&
           trace & TraceAccess.WORD_LO
         );
 
@@ -395,11 +328,9 @@ export default class Tracer extends EventTarget {
         } while (
           parameters.length < MAX_DATA_BYTES &&
           index < data.length &&
-          !this.labels[address] &&
-          !(
-            this.trace[address] &
-            (TraceAccess.WORD_LO | TraceAccess.INSTRUCTION)
-          )
+          !this.label(address) &&
+          !(this.trace[address] & TraceAccess.WORD_LO) &&
+          !this.isCode(address)
         );
         render.push({
           operation: 'DB',
@@ -410,84 +341,157 @@ export default class Tracer extends EventTarget {
     }
 
     render.forEach((block) => {
-      if (this.labels[block.address]) block.label = this.labels[block.address];
+      const label = this.label(block.address);
+      if (label) block.label = label;
     });
 
     return render;
   }
 
-  update() {
-    Object.keys(this.traceBank).forEach((page) => {
-      const detail = this.traceBank[page];
-      this.dispatchEvent(new CustomEvent(`trace:changed[${page}]`, { detail }));
-    });
-    this.dirty = {};
+  // Executed code, or code static analysis found where nothing was traced yet
+  private isCode(address: number) {
+    const trace = this.trace[address];
+
+    if (trace !== TraceAccess.NONE) {
+      return (trace & TraceAccess.INSTRUCTION) !== 0;
+    }
+    return (this.system.state.analysis.map[address] & ATTR_CODE) !== 0;
   }
 
-  forceTrace(address: number, kind: number) {
-    const mask = ~(TraceAccess.READ | TraceAccess.WRITE);
+  // Names from branches seen at run time, then destinations found statically
+  private label(address: number) {
+    const attributes = this.system.state.analysis.map[address];
+    if (
+      this.trace[address] & TraceAccess.BRANCH_TARGET ||
+      attributes & (ATTR_BRANCH | ATTR_CALL | ATTR_ENTRY)
+    ) {
+      return `loc_${address.toString(16)}`;
+    }
+  }
 
-    // Trace accesses, with clear on write to ram
-    this.trace[address] = kind & mask;
+  // Static analysis replaced what every page shows
+  invalidate() {
+    Object.keys(this.traceBank).forEach((page) => this.changed(page));
+  }
 
-    // Mark altered banks as dirty
-    let bank;
+  formatParameters(record: DisassemblyRecord) {
+    const parameters = [];
 
-    if (address < 0x1000) {
-      bank = 'bios';
-    } else if (address < 0x2000) {
-      bank = 'ram';
-    } else {
-      bank = `rom:${address >> 15}`;
+    if (record.condition !== Table.Condition.NONE) {
+      parameters.push(
+        `<span class="condition">${Conditions[record.condition]}</span>`,
+      );
     }
 
-    this.traceBank[bank].dirty = true;
+    for (let i = 0; i < 2; i++) {
+      if (record.arguments[i] !== ARGUMENT_NONE) {
+        parameters.push(
+          this.formatArgument(record, record.arguments[i], record.operands[i]),
+        );
+      }
+    }
 
-    const detail = this.traceBank[bank];
-    this.dispatchEvent(new CustomEvent(`trace:changed[${bank}]`, { detail }));
+    return parameters.join(HTMLComma);
   }
 
-  traceAccess(cpu: number, address: number, kind: number, data: number) {
-    const prev = this.trace[address];
-    const mask = ~(TraceAccess.READ | TraceAccess.WRITE);
+  private formatArgument(record: DisassemblyRecord, arg: number, value: number) {
+    const disp = (value << 16) >> 16;
 
-    // We do not need to trace register writes
-    if (address >= 0x2000 && address <= 0x20ff) {
-      return;
+    if (Registers[arg]) {
+      return register(Registers[arg]);
     }
 
-    // Trace accesses, with clear on write to ram
-    if (kind & TraceAccess.WRITE) {
-      if (address >= 0x2100) {
-        return;
-      }
+    switch (arg) {
+      case Table.Argument.MEM_HL:
+        return memory(register('HL'));
+      case Table.Argument.MEM_IX:
+        return memory(register('IX'));
+      case Table.Argument.MEM_IY:
+        return memory(register('IY'));
+      case Table.Argument.MEM_IX_OFF:
+        return memory(register('IX'), '<span class="symbol">+</span>', register('L'));
+      case Table.Argument.MEM_IY_OFF:
+        return memory(register('IY'), '<span class="symbol">+</span>', register('L'));
+      case Table.Argument.MEM_SP_DISP:
+        return `[SP${signed(disp)}]`;
+      case Table.Argument.MEM_IX_DISP:
+        return `[IX${signed(disp)}]`;
+      case Table.Argument.MEM_IY_DISP:
+        return `[IY${signed(disp)}]`;
+      case Table.Argument.MEM_ABS16:
+        return memory(`<span class="literal">0${format(value, 4)}h</span>`);
+      case Table.Argument.MEM_BR:
+        return memory(
+          register('BR'),
+          '<span class="symbol">:</span>',
+          `<span class="literal">0${format(value)}h</span>`,
+        );
+      case Table.Argument.MEM_VECTOR:
+        return memory(`<span class="literal">0${format(value)}h</span>`);
+      case Table.Argument.IMM_8:
+        return `<span class="literal">#0${format(value)}h</span>`;
+      case Table.Argument.IMM_16:
+        return `<span class="literal">#0${format(value, 4)}h</span>`;
+      case Table.Argument.REL_8:
+      case Table.Argument.REL_16:
+        return this.formatTarget(record, disp);
+    }
+  }
+
+  private formatTarget(record: DisassemblyRecord, disp: number) {
+    const { target } = record;
 
-      this.trace[address] = kind & mask;
-    } else {
-      this.trace[address] |= kind & mask;
+    if (target === NO_TARGET) {
+      // Lands in the banked window while NB is unknown, show the logical PC
+      const pc =
+        record.address < 0x8000
+          ? record.address
+          : 0x8000 | (record.address & 0x7fff);
+      const logical = (pc + record.length - 1 + disp) & 0xffff;
+
+      return `<span class="literal">#${format(logical, 4)}h</span>`;
     }
 
-    if (
-      kind & TraceAccess.BRANCH_TARGET &&
-      this.labels[address] === undefined
-    ) {
-      this.labels[address] = `loc_${address.toString(16)}`;
+    const label = this.label(target);
+    if (label) {
+      return `<span class="identifier" data-address="${target}">${label}</span>`;
     }
+    return `<span class="literal" data-address="${target}">#${format(target, 6)}h</span>`;
+  }
 
-    // Mark altered banks as dirty
-    if (prev !== this.trace[address]) {
-      let bank;
+  private changed(page: string) {
+    const detail = this.traceBank[page];
 
-      if (address < 0x1000) {
-        bank = 'bios';
-      } else if (address < 0x2000) {
-        bank = 'ram';
-      } else {
-        bank = `rom:${address >> 15}`;
-      }
+    detail.dirty = true;
+    this.dispatchEvent(new CustomEvent(`trace:changed[${page}]`, { detail }));
+  }
 
-      this.traceBank[bank].dirty = this.dirty[bank] = true;
+  // Pages shown for a bank of the core's trace
+  private pages(bank: number) {
+    return bank === 0 ? ['bios', 'ram', 'rom:0'] : [`rom:${bank}`];
+  }
+
+  // Only banks whose attributes changed since the last update are redrawn
+  update() {
+    const { generation } = this.system.state.trace;
+
+    if (generation === this.generation) {
+      return;
     }
+
+    const banks = this.system.traceChanged(this.generation);
+    this.generation = generation;
+
+    for (let bank = 0; bank < BANK_COUNT; bank++) {
+      if ((banks >> BigInt(bank)) & 1n) {
+        this.pages(bank).forEach((page) => this.changed(page));
+      }
+    }
+  }
+
+  forceTrace(address: number, kind: number) {
+    this.system.traceSet(address, kind);
+    this.update();
   }
 
   unrollStack() {